@@ -2,10 +2,12 @@
 
 @section CubigelExample_intro_section Description
 This program is a simple example for the Cubigel compressor communications library class. The class,
-once instantiated, will automatically collect statistics in the background using an interrupt so
-that any program using the library can do any processing it needs until such time as it requests the
-most recent statistics. The system settings are only collected once when the class is instantiated,
-any subsequent changes by another program will not get picked up.
+once instantiated and the devices added, will automatically collect statistics in the background
+using an interrupt so that any program using the library can do any processing it needs until such
+time as it requests the most recent statistics. The system settings are collected when each device
+is added and are then refreshed every 10 minutes using "setSettingsRefresh()", so that later changes
+get picked up. The SoftwareSerial port can't be written to from the interrupt, so "poll()" is
+called from "loop()" to send the mode commands to the fridge.
 
 The "SoftwareSerial library" (see https://www.arduino.cc/en/Reference/SoftwareSerial) can be used
 for one device, but not for more. This is because the library only looks for pin change interrupts
@@ -33,6 +35,9 @@ Written by Arnd <Arnd@Zanduino.Com> at https://www.github.com/SV-Zanshin
 
 Version | Date       | Developer  | Comments
 ------- | ---------- | ---------- | ---------------------------------------------------------------
+2.0.2   | 2026-10-16 | SV-Zanshin | Call poll() so the fridge's mode commands get sent
+2.0.1   | 2026-10-16 | SV-Zanshin | Refresh the settings every 10 minutes with setSettingsRefresh()
+2.0.0   | 2026-10-16 | SV-Zanshin | Use CubigelBank<N> and addDevice() instead of the constructors
 1.0.4   | 2020-12-07 | SV-Zanshin | Reformatted using doxygen comments
 1.0.3   | 2020-06-28 | SV-Zanshin | Changed comment style to clang-format LLVM
 1.0.2   | 2020-06-25 | SV-Zanshin | Fixed comments
@@ -45,11 +50,12 @@ Version | Date       | Developer  | Comments
 ///< Define the different types of devices
 enum DeviceName { Fridge, Freezer, LastElement };
 const uint32_t INTERVAL_MILLIS{60000};  ///< default 60s interval between readings
+const uint16_t REFRESH_SECONDS{600};    ///< Settings are requested again every 10 minutes
 const uint8_t  FRIDGE_RX_PIN{52};       ///< Pin for fridge serial receive RX
 const uint8_t  FRIDGE_TX_PIN{53};       ///< Pin for fridge serial transmit TX
 SoftwareSerial FridgeSerial(FRIDGE_RX_PIN, FRIDGE_TX_PIN);  ///< Instantiate Fridge serial port
-CubigelClass   Cubigel(&FridgeSerial, &Serial1);            ///< One soft and one hardware port
-static char    sprintfBuffer[32];                           ///< Buffer for formatted text output
+CubigelBank<LastElement> Cubigel;                ///< Storage for the fridge and freezer devices
+static char              sprintfBuffer[32];      ///< Buffer for formatted text output
 
 void setup() {
   /*!
@@ -64,9 +70,12 @@ void setup() {
   delay(3000);
 #endif
   while (!Serial) {};  // Give serial port time to start
-  Serial.println(F("Cubigel example program [v1.0.4]"));
-  delay(1100);  // 2 sentences get sent per second,
-  delay(1100);  // Repeat for first data sentence
+  Serial.println(F("Cubigel example program [v2.0.2]"));
+  Cubigel.addDevice(&FridgeSerial);             // The fridge uses a software serial port
+  Cubigel.addDevice(&Serial1);                  // and the freezer the second UART
+  Cubigel.setSettingsRefresh(REFRESH_SECONDS);  // Pick up later settings changes
+  delay(1100);                                  // 2 sentences get sent per second,
+  delay(1100);                                  // Repeat for first data sentence
   Serial.println(
       F("_______________________________________________________________________________"));
   Serial.println(
@@ -132,6 +141,7 @@ void loop() {
   static unsigned long nextInterval  = 0;                   // store time for next display
   static uint32_t      tempStartTime = 0;                   // store the last compressor start
   static uint32_t      tempStopTime  = 0;                   // store the last compressor stop
+  Cubigel.poll();                                           // Send the fridge's mode commands
   if (millis() > nextInterval) {                            // If it is time to display values
     uint16_t readings, RPM, mA, CommsErrors, CubigelError;  // Temporary variables
     for (uint8_t idx = 0; idx < LastElement; idx++) {       // Loop for every device enumerated
@@ -0,0 +1,76 @@
+/*! @file CubigelPolled.ino
+
+@section CubigelPolled_intro_section Description
+This program reads a single compressor connected to the "Serial1" hardware port without using any
+interrupt of its own. The bank is declared with CUBIGEL_POLLED and "poll()" is called every time
+through "loop()", which processes whatever bytes have arrived since the last call. Since neither the
+Timer0 interrupt nor the SoftwareSerial library is used this example runs on any board which has a
+spare hardware UART, e.g. an Arduino Zero or a Mega.
+
+Every 10 seconds the number of readings, the average speed and current and the number of comms
+errors since the last output are shown on the serial monitor. Nothing is shown until the compressor
+has sent at least one reading.
+
+@section CubigelPolledLicense License
+
+This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+General Public License as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version. This program is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details. You should have
+received a copy of the GNU General Public License along with this program.  If not, see
+<http://www.gnu.org/licenses/>.
+
+@section CubigelPolledAuthor Author
+
+Written by Arnd <Arnd@Zanduino.Com> at https://www.github.com/SV-Zanshin
+
+@section CubigelPolledVersions Changelog
+
+Version | Date       | Developer  | Comments
+------- | ---------- | ---------- | ---------------------------------------------------------------
+1.0.0   | 2026-10-16 | SV-Zanshin | Initial coding
+*/
+
+#include <Cubigel.h>                     // Include Cubigel library
+const uint32_t INTERVAL_MILLIS{10000};   ///< 10s interval between outputs
+CubigelBank<1> Cubigel(CUBIGEL_POLLED);  ///< Storage for the compressor, read by poll()
+
+void setup() {
+  /*!
+    @brief    Arduino method called once at startup to initialize the system
+    @details  The compressor is added on the first hardware UART, the USB serial port is used for
+              the output
+    @return   void
+  */
+  Serial.begin(115200);         // Initialize Serial I/O at speed
+  while (!Serial) {};           // Give serial port time to start
+  Serial.println(F("Cubigel polled example program [v1.0.0]"));
+  Cubigel.addDevice(&Serial1);  // The compressor is on the first UART
+}  // of method "setup()"
+
+void loop() {
+  /*!
+    @brief    Arduino method for the main program loop
+    @details  poll() is called on every pass, which needs to happen at least every 50ms so that the
+              receive buffer doesn't overflow. The values are shown once per interval
+    @return   void
+  */
+  static uint32_t lastInterval = 0;                    // store time of the last output
+  Cubigel.poll();                                      // Process the bytes that have arrived
+  if (millis() - lastInterval >= INTERVAL_MILLIS) {    // If it is time to show the values
+    lastInterval += INTERVAL_MILLIS;                   // Keep to the schedule
+    uint16_t RPM, mA, commsErrors, errorStatus;        // Temporary variables
+    uint16_t readings = Cubigel.readValues(0, RPM, mA, commsErrors, errorStatus);  // Read, reset
+    if (readings) {                                    // Only show something once data arrived
+      Serial.print(readings);                          // Show the values
+      Serial.print(F(" readings, "));
+      Serial.print(RPM);
+      Serial.print(F(" RPM, "));
+      Serial.print(mA);
+      Serial.print(F(" mA, "));
+      Serial.print(commsErrors);
+      Serial.println(F(" comms errors"));
+    }  // of if-then there are readings
+  }    // of if-then time to show the values
+}  // of method loop()
@@ -0,0 +1,74 @@
+/*! @file CubigelTelemetry.ino
+
+@section CubigelTelemetry_intro_section Description
+This program shows how to send the statistics for several compressors to a gateway computer as
+binary records rather than as formatted text. Every interval "packTelemetry()" writes a 41 byte
+record for each device into a buffer, which is then sent over the USB serial port with a single
+"Serial.write()" call. Nothing is formatted with sprintf() on the Arduino, and the gateway gets the
+average, lowest and highest RPM and current, the error counts and the cycle times at fixed places
+in the record rather than having to parse text.
+
+The records are decoded on the gateway by the "CubigelTelemetryDecoder" class in the
+"extras/host/CubigelTelemetry.h" file, which checks the CRC-16 of each record and finds the start of
+the next one if any bytes are lost on the way. The serial port is used for the binary data only, so
+the serial monitor in the Arduino IDE won't show anything readable.
+
+This example uses 4 hardware UARTs and therefore needs an ATMega2560 or similar, the compressors
+are connected to Serial1, Serial2 and Serial3.
+
+@section CubigelTelemetryLicense License
+
+This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+General Public License as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version. This program is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details. You should have
+received a copy of the GNU General Public License along with this program.  If not, see
+<http://www.gnu.org/licenses/>.
+
+@section CubigelTelemetryAuthor Author
+
+Written by Arnd <Arnd@Zanduino.Com> at https://www.github.com/SV-Zanshin
+
+@section CubigelTelemetryVersions Changelog
+
+Version | Date       | Developer  | Comments
+------- | ---------- | ---------- | ---------------------------------------------------------------
+1.0.0   | 2026-10-16 | SV-Zanshin | Initial coding
+*/
+
+#include <Cubigel.h>                                   // Include Cubigel library
+const uint8_t  DEVICES{3};                             ///< Number of compressors connected
+const uint32_t INTERVAL_MILLIS{10000};                 ///< 10s interval between records
+CubigelBank<DEVICES> Cubigel;                          ///< Storage for the compressors
+static uint8_t       record[CUBIGEL_TELEMETRY_BYTES];  ///< Buffer for one binary record
+
+void setup() {
+  /*!
+    @brief    Arduino method called once at startup to initialize the system
+    @details  The gateway is connected to the USB serial port, which runs much faster than the
+              1200 baud used by the compressors
+    @return   void
+  */
+  Serial.begin(115200);           // Initialize Serial I/O at speed
+  Cubigel.addDevice(&Serial1);    // Add the compressors
+  Cubigel.addDevice(&Serial2);    //
+  Cubigel.addDevice(&Serial3);    //
+}  // of method "setup()"
+
+void loop() {
+  /*!
+    @brief    Arduino method for the main program loop
+    @details  Sends one record per device every interval, resetting the statistics so that each
+              record covers the time since the previous one
+    @return   void
+  */
+  static uint32_t lastInterval = 0;                        // store time of the last records
+  if (millis() - lastInterval >= INTERVAL_MILLIS) {        // If it is time to send records
+    lastInterval += INTERVAL_MILLIS;                       // Keep to the schedule
+    for (uint8_t idx = 0; idx < DEVICES; idx++) {          // Loop for every device
+      uint8_t bytes = Cubigel.packTelemetry(idx, record, sizeof(record));  // Read and reset
+      Serial.write(record, bytes);                         // Send the record as it is
+    }                                                      // of for-next loop for each device
+  }                                                        // of if-then time to send
+}  // of method loop()
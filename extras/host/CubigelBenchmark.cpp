@@ -0,0 +1,541 @@
+/***************************************************************************************************
+** Host benchmark and regression check for the Cubigel library sentence decoding. See the         **
+** "README.md" file in this directory for instructions on how to compile and run it.              **
+** This program is free software: you can redistribute it and/or modify it under the terms of the **
+** GNU General Public License as published by the Free Software Foundation, either version 3 of   **
+** the License, or (at your option) any later version. This program is distributed in the hope    **
+** that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of         **
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   **
+** more details. You should have received a copy of the GNU General Public License along with     **
+** this program.  If not, see <http://www.gnu.org/licenses/>.                                     **
+**                                                                                                **
+***************************************************************************************************/
+#include <stdio.h>   // printf()
+#include <stdlib.h>  // atoi()
+
+#include "Cubigel.h"           // Cubigel library
+#include "CubigelSimulator.h"  // Simulated compressor
+#include "CubigelTelemetry.h"  // Telemetry record decoder
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>            // __rdtsc() for cycle counts
+  #define BENCH_CYCLES() __rdtsc()  ///< Read the CPU time stamp counter
+#else
+  #define BENCH_CYCLES() 0  ///< No cycle counter available
+#endif
+
+const uint16_t BLOCK_SENTENCES{2000};  ///< Sentences per block, keeps readings below 65535
+
+struct Options {
+  /*!
+    @brief Command line options
+  */
+  uint32_t sentences  = 1000000;    ///< Sentences to decode in the throughput test
+  uint16_t faultRate  = 50;         ///< Faults of each type per 10000 sentences
+  uint8_t  settingsEvery = 10;      ///< Every n-th sentence is a type 80, 0 for none
+  uint32_t seconds    = 120;        ///< Simulated seconds for the paced test
+  uint16_t pollMillis = 0;          ///< Milliseconds between poll() calls, 0 for timer mode
+  bool     eventDriven = false;     ///< Freezer port read by onReceive() in the paced test
+  bool     softwareSerial = false;  ///< Fridge on a SoftwareSerial port in the paced test
+};
+
+static uint16_t eventCount[CUBIGEL_SETTINGS_CHANGED + 1][2];  ///< Events seen per kind and device
+static uint8_t  lastAlarm[2];                       ///< Last alarm code reported per device
+
+static void countEvent(const CubigelEventType &event) {
+  /*!
+    @brief     Callback for the transition and alarm events in the paced test
+    @param[in] event The event taken off the queue by dispatchEvents()
+  */
+  ++eventCount[event.kind][event.device];
+  if (event.kind == CUBIGEL_ALARM) lastAlarm[event.device] = event.alarm;
+}  // of function countEvent()
+
+struct SampleTotals {
+  /*!
+    @brief The charge and running time worked out from the history samples, the same way as the
+           library integrates them, to check readEnergy() against
+  */
+  uint32_t last      = 0;  ///< Time of the previous sample, 0 before the first
+  uint32_t runMillis = 0;  ///< Milliseconds covered while running
+  uint64_t charge    = 0;  ///< mA x ms
+};
+
+static uint8_t addSamples(SampleTotals &totals, const CubigelSampleType *samples,
+                          const uint8_t count) {
+  /*!
+    @brief     Add the time since the previous sample, limited to CUBIGEL_MAX_FRAME_GAP as lost
+               sentences are, and the charge at the sample's current over that time
+    @param[in] totals  Running totals to add to
+    @param[in] samples Samples read by readHistory()
+    @param[in] count   Number of samples
+    @return    count, so that the call can be added to the samples read
+  */
+  for (uint8_t i = 0; i < count; ++i) {
+    if (totals.last) {
+      uint32_t gap = samples[i].time - totals.last;
+      if (gap > CUBIGEL_MAX_FRAME_GAP) gap = CUBIGEL_MAX_FRAME_GAP;
+      totals.charge += (uint64_t)samples[i].mA * gap;
+      if (samples[i].RPM) totals.runMillis += gap;
+    }  // of if-then not the first sample
+    totals.last = samples[i].time;
+  }  // of for-next each sample
+  return count;
+}  // of function addSamples()
+
+static bool pacedTest(const Options &options) {
+  /*!
+    @brief     Run two simulated compressors at the real baud rate and sentence interval against the
+               simulated clock and check that the library reads their settings and values
+    @param[in] options Command line options
+    @return    true when the decoded values match what the simulators sent
+  */
+  HardwareSerial     fridgeHardware, freezerPort;
+  SoftwareSerial     fridgeSoftware(10, 11);
+  CubigelHostSerial &fridgePort = options.softwareSerial
+                                      ? static_cast<CubigelHostSerial &>(fridgeSoftware)
+                                      : static_cast<CubigelHostSerial &>(fridgeHardware);
+  CubigelSimulator   fridge(fridgePort, 1), freezer(freezerPort, 2);
+  fridge.setRunning(2500, 3200);
+  freezer.setRunning(0, 0, 4);  // Freezer is off with a fan over-current alarm
+  freezer.setSettings(2500, 3000, 8);
+  fridge.setFaultRates(options.faultRate, options.faultRate, options.faultRate, options.faultRate);
+  CubigelBank<2> cubigel(options.pollMillis ? CUBIGEL_POLLED : CUBIGEL_TIMER);
+  if (options.softwareSerial) {
+    cubigel.addDevice(&fridgeSoftware);
+  } else {
+    cubigel.addDevice(&fridgeHardware);
+  }  // of if-then-else fridge on a software port
+  cubigel.addDevice(&freezerPort, options.eventDriven ? CUBIGEL_EVENT : CUBIGEL_TIMER);
+  CubigelSampleType history[8], samples[8];  // Fridge history ring buffer and batch
+  uint32_t          sampled = 0;             // Samples read from the history
+  SampleTotals      totals;                  // Charge and run time from those samples
+  uint64_t          cycles  = 0;             // Time spent reading the ports
+  cubigel.setHistory(0, history, 8);
+  cubigel.setTransitionCallback(countEvent);
+  cubigel.setAlarmCallback(countEvent);
+  cubigel.setSettingsCallback(countEvent);
+  cubigel.setSettingsRefresh(20);           // Ask for the settings every 20 seconds
+  bool     wasSettings[2] = {false, false};  // Simulators sending settings last millisecond
+  uint32_t requested[2]   = {0, 0};          // Last time each one was asked for its settings
+  uint32_t refreshes = 0, closest = UINT32_MAX;  // Settings requests and closest two devices
+  for (uint32_t ms = 0; ms < options.seconds * 1000; ++ms) {  // Every simulated millisecond
+    fridge.update();
+    freezer.update();
+    if (ms == options.seconds * 500) freezer.setSettings(2600, 3000, 8);  // Change half way
+    bool isSettings[2] = {fridge.settingsMode(), freezer.settingsMode()};
+    for (uint8_t i = 0; i < 2; ++i) {
+      if (isSettings[i] && !wasSettings[i] && ms > 1000) {  // A refresh request arrived
+        ++refreshes;
+        requested[i]  = ms;
+        uint32_t apart = requested[0] > requested[1] ? requested[0] - requested[1]
+                                                     : requested[1] - requested[0];
+        if (requested[0] && requested[1] && apart < closest) closest = apart;
+      }  // of if-then a settings request arrived
+      wasSettings[i] = isSettings[i];
+    }  // of for-next each simulator
+    uint64_t start = BENCH_CYCLES();
+    if (!options.pollMillis) {  // Timer mode, the interrupt runs every millisecond
+      CubigelClass::TimerISR();
+    } else if (ms % options.pollMillis == 0) {  // Polled mode, the program calls poll()
+      cubigel.poll();
+    }                                                   // of if-then-else timer or polled mode
+    if (freezerPort.available()) cubigel.onReceive(1);  // What serialEvent() does after loop()
+    cycles += BENCH_CYCLES() - start;
+    if (!options.pollMillis) cubigel.poll();  // loop() sends the SoftwareSerial mode commands
+    CubigelHost::advance(1);
+    if (ms % 2000 == 0) {  // Read a batch every 2 seconds
+      sampled += addSamples(totals, samples, cubigel.readHistory(0, samples, 8));
+    }  // of if-then time to read the history
+    if (ms % 5000 == 0) cubigel.dispatchEvents();                       // Events every 5 seconds
+  }  // of for-next each simulated millisecond
+  sampled += addSamples(totals, samples, cubigel.readHistory(0, samples, 8));  // and what is left
+  cubigel.dispatchEvents();
+  bool     passed = true;
+  uint16_t rpm, mA, commsErrors, errorStatus;
+  uint16_t compMin, compMax, out12V, in12V, out24V, in24V, out42V, in42V;
+  uint8_t  mode;
+  CubigelSummaryType summary = cubigel.readStatistics(0, false);  // Read without resetting
+  uint16_t peek     = cubigel.readValues(0, rpm, mA, false);      // Read without resetting
+  CubigelEnergyType  energy  = cubigel.readEnergy(0);
+  uint8_t                 record[CUBIGEL_TELEMETRY_BYTES + 1];  // Binary record, with room to spare
+  CubigelTelemetryDecoder decoder;
+  CubigelTelemetryRecord  telemetry = {};
+  uint8_t packed  = cubigel.packTelemetry(0, record, sizeof(record), false);
+  bool    decoded = false;
+  decoder.decode(CUBIGEL_TELEMETRY_SYNC, telemetry);  // A stray sync byte, then a corrupted copy
+  record[20] ^= 1;
+  for (uint8_t i = 0; i < packed; ++i) decoder.decode(record[i], telemetry);
+  record[20] ^= 1;
+  for (uint8_t i = 0; i < packed; ++i) decoded = decoder.decode(record[i], telemetry);
+  uint16_t readings = cubigel.readValues(0, rpm, mA, commsErrors, errorStatus);
+  cubigel.readSettings(0, compMin, compMax, out12V, in12V, out24V, in24V, out42V, in42V, mode);
+  printf("Paced test, %u simulated seconds, ", (unsigned)options.seconds);
+  if (options.pollMillis) {
+    printf("poll() every %u ms", options.pollMillis);
+  } else {
+    printf("timer interrupt every ms");
+  }  // of if-then-else polled mode
+  if (options.eventDriven) printf(", freezer event driven");
+  if (options.softwareSerial) printf(", fridge on SoftwareSerial");
+  printf(", %.0f cycles per simulated second reading the ports\n",
+         cycles / (double)options.seconds);
+  printf("  Fridge : %u readings, %u RPM, %u mA, %u comms errors, settings %u/%u mode %u\n",
+         readings, rpm, mA, commsErrors, compMin, compMax, mode);
+  printf("           %u good sentences sent, cut-out/in 12V %u/%u mV\n",
+         (unsigned)fridge.sentences(SIM_OK), out12V, in12V);
+  passed &= rpm >= 2500 && rpm < 2532 && mA >= 3150 && mA < 3264 && compMin == 2000;
+  passed &= !fridge.settingsMode() && readings > 0;
+  printf("           RPM %u-%u variance %u, mA %u-%u variance %u\n", summary.minRPM, summary.maxRPM,
+         (unsigned)summary.varianceRPM, summary.minmA, summary.maxmA, (unsigned)summary.variancemA);
+  passed &= summary.readings == readings && summary.running == readings && summary.RPM == rpm;
+  passed &= summary.minRPM >= 2500 && summary.maxRPM < 2532 && summary.minRPM < summary.maxRPM;
+  passed &= summary.varianceRPM > 40 && summary.varianceRPM < 130;  // Uniform 0-31 jitter is 85
+  passed &= !summary.saturated;
+  uint32_t expectedmAh = totals.charge / 3600000;  // Integrated from the decoded samples
+  printf("           %u mAh, %u mWh, %u s running, %u s stopped, duty %u.%02u%%, %u cycles\n",
+         (unsigned)energy.mAh, (unsigned)energy.mWh, (unsigned)energy.runSeconds,
+         (unsigned)energy.stopSeconds, energy.dutyCycle / 100, energy.dutyCycle % 100,
+         energy.cycles);
+  passed &= energy.mAh >= expectedmAh;  // The samples' mA are rounded down by up to 1 mA
+  passed &= energy.mAh <= expectedmAh + 1 + totals.runMillis / 3600000;
+  passed &= energy.mWh / 12 >= energy.mAh && energy.mWh / 12 <= energy.mAh + 1;
+  passed &= energy.runSeconds == totals.runMillis / 1000 && energy.runSeconds <= options.seconds;
+  passed &= energy.stopSeconds == 0 && energy.dutyCycle == 10000 && energy.cycles == 1;
+  passed &= peek == readings && cubigel.readValues(0, rpm, mA) == 0;  // Reset leaves nothing
+  printf("           %u history samples read, %u dropped\n", (unsigned)sampled,
+         cubigel.readHistoryDropped(0));
+  passed &= sampled == readings && cubigel.readHistoryDropped(0) == 0;
+  printf("           %u byte telemetry record covering %u ms, %u decoded, %u CRC errors, %u bytes "
+         "skipped\n",
+         packed, (unsigned)telemetry.interval, (unsigned)decoder.records(),
+         (unsigned)decoder.crcErrors(), (unsigned)decoder.skipped());
+  passed &= packed == CUBIGEL_TELEMETRY_BYTES && decoded && decoder.records() == 1;
+  passed &= decoder.crcErrors() == 1 && cubigel.packTelemetry(0, record, packed - 1) == 0;
+  passed &= telemetry.device == 0 && telemetry.time == millis() && telemetry.readings == readings;
+  passed &= telemetry.interval == options.seconds * 1000 && telemetry.running == summary.running;
+  passed &= telemetry.RPM == summary.RPM && telemetry.minRPM == summary.minRPM;
+  passed &= telemetry.maxRPM == summary.maxRPM && telemetry.mA == summary.mA;
+  passed &= telemetry.minmA == summary.minmA && telemetry.maxmA == summary.maxmA;
+  passed &= telemetry.commsErrors == summary.commsErrors;
+  passed &= telemetry.errorStatus == summary.errorStatus && telemetry.cycles == energy.cycles;
+  passed &= telemetry.dutyCycle == energy.dutyCycle;
+  passed &= telemetry.cycleSeconds == energy.cycleSeconds;
+  CubigelLinkType link = cubigel.readLinkStats(0);
+  uint32_t        gaps = 0;  // Sentences in the gap histogram
+  printf("           link %u bytes, %u sentences, %u bad start, %u bad type, %u bad checksum, gaps",
+         (unsigned)link.bytes, (unsigned)link.frames, link.badStart, link.badType,
+         link.badChecksum);
+  for (uint8_t i = 0; i < CUBIGEL_GAP_BUCKETS; ++i) {
+    printf(" %u", link.gaps[i]);
+    gaps += link.gaps[i];
+  }  // of for-next each histogram bucket
+  printf("\n");
+  passed &= link.badStart + link.badType + link.badChecksum == commsErrors;  // Never reset
+  passed &= gaps + 1 == readings && link.frames > readings && link.bytes > link.frames * 8;
+  if (options.faultRate > 0) {                              // Faults injected
+    passed &= link.badStart > 0 && link.badChecksum > 0;    // Some of the faults
+  } else {                                                  // otherwise
+    passed &= link.badStart == 0 && link.badChecksum == 0;  // a clean link
+  }                                                         // of if-then faults
+  readings = cubigel.readValues(1, rpm, mA, commsErrors, errorStatus);
+  cubigel.readSettings(1, compMin, compMax, out12V, in12V, out24V, in24V, out42V, in42V, mode);
+  printf("  Freezer: %u readings, %u RPM, %u mA, %u comms errors, alarms %u, settings %u/%u "
+         "mode %u\n",
+         readings, rpm, mA, commsErrors, errorStatus, compMin, compMax, mode);
+  passed &= readings > 0 && rpm == 0 && commsErrors == 0 && errorStatus == 4;
+  link = cubigel.readLinkStats(1, true);  // Read and reset, the freezer has a clean link
+  passed &= link.badStart == 0 && link.badType == 0 && link.badChecksum == 0;
+  passed &= link.gaps[1] > link.gaps[2] && link.gaps[2] > 0 && link.gaps[0] == 0;  // Refreshes
+  link = cubigel.readLinkStats(1);
+  passed &= link.bytes == 0 && link.frames == 0 && link.gaps[1] == 0;
+  cubigel.setSupplyVoltage(1, CUBIGEL_24V);
+  energy = cubigel.readEnergy(1);
+  passed &= energy.mAh == 0 && energy.runSeconds == 0 && energy.stopSeconds + 1 >= options.seconds;
+  passed &= energy.dutyCycle == 0 && energy.cycles == 0 && energy.supplyVoltage == CUBIGEL_24V;
+  passed &= compMin == 2600 && compMax == 3000 && mode == 8 && !freezer.settingsMode();
+  printf("  Refresh: %u settings requests, closest %u ms apart, %u changes seen\n",
+         (unsigned)refreshes, (unsigned)closest, eventCount[CUBIGEL_SETTINGS_CHANGED][1]);
+  passed &= refreshes + 2 >= options.seconds / 10 && closest >= 5000;
+  passed &= eventCount[CUBIGEL_SETTINGS_CHANGED][0] == 0;
+  passed &= eventCount[CUBIGEL_SETTINGS_CHANGED][1] == 1;
+  passed &= !cubigel.settingsChanged(0) && cubigel.settingsChanged(1);
+  passed &= !cubigel.settingsChanged(1);  // Only reported once
+  uint32_t onTime, offTime;
+  bool     changed = cubigel.readTiming(1, onTime, offTime);
+  printf("  Events : fridge %u on, %u off, %u alarm; freezer %u on, %u off, %u alarm (code %u)\n",
+         eventCount[CUBIGEL_TURNED_ON][0], eventCount[CUBIGEL_TURNED_OFF][0],
+         eventCount[CUBIGEL_ALARM][0], eventCount[CUBIGEL_TURNED_ON][1],
+         eventCount[CUBIGEL_TURNED_OFF][1], eventCount[CUBIGEL_ALARM][1], lastAlarm[1]);
+  passed &= eventCount[CUBIGEL_TURNED_ON][0] == 1 && eventCount[CUBIGEL_TURNED_OFF][0] == 0;
+  passed &= eventCount[CUBIGEL_TURNED_ON][1] == 0 && eventCount[CUBIGEL_TURNED_OFF][1] == 1;
+  passed &= eventCount[CUBIGEL_ALARM][0] == 0 && eventCount[CUBIGEL_ALARM][1] == 1;
+  passed &= lastAlarm[1] == 4 && cubigel.readEventsDropped() == 0;
+  passed &= changed && !cubigel.readTiming(1, onTime, offTime) && offTime > 0;
+  passed &= cubigel.readHealth(0) == 0 && cubigel.readHealth(1) == CUBIGEL_HEALTH_ALARM;
+#if defined(CUBIGEL_PROFILE)
+  CubigelProfileType profile = cubigel.readProfile();
+  printf("  Profile: %u busy and %u idle ticks, tick %u/%u/%u ns min/mean/max, byte %u ns max, "
+         "interrupts off %u ns max\n",
+         (unsigned)profile.busyTicks, (unsigned)profile.idleTicks,
+         (unsigned)(profile.minTime * CUBIGEL_PROFILE_NS),
+         (unsigned)(profile.meanTime * CUBIGEL_PROFILE_NS),
+         (unsigned)(profile.maxTime * CUBIGEL_PROFILE_NS),
+         (unsigned)(profile.maxByteTime * CUBIGEL_PROFILE_NS),
+         (unsigned)(profile.maxOffTime * CUBIGEL_PROFILE_NS));
+  passed &= profile.maxByteTime > 0;  // Bytes were processed in every mode
+  if (!options.pollMillis) {          // Only the timer interrupt counts ticks
+    passed &= profile.busyTicks > 0 && profile.idleTicks > 0;
+    passed &= profile.minTime <= profile.meanTime && profile.meanTime <= profile.maxTime;
+  }  // of if-then timer mode
+  profile = cubigel.readProfile();
+  passed &= profile.busyTicks == 0 && profile.idleTicks == 0 && profile.maxTime == 0;
+#endif
+  return passed;
+}  // of function pacedTest()
+
+static bool healthTest() {
+  /*!
+    @brief     Run a simulated compressor through a current change, failed starts, short cycles and
+               an alarm, checking that the health flags are raised and cleared at the right times
+    @return    true when every flag was as expected
+  */
+  HardwareSerial   port;
+  CubigelSimulator compressor(port, 4);
+  CubigelBank<1>   cubigel;
+  cubigel.addDevice(&port);
+  bool passed = true;
+  auto run    = [&](const uint32_t seconds) {  // Run the simulation for a while
+    for (uint32_t ms = 0; ms < seconds * 1000; ++ms) {
+      compressor.update();
+      CubigelClass::TimerISR();
+      CubigelHost::advance(1);
+    }                                 // of for-next each simulated millisecond
+  };                                  // of lambda run()
+  compressor.setRunning(2500, 3200);  // Learn the normal current
+  run(60);
+  CubigelHealthReportType report = cubigel.readHealthReport(0);
+  uint16_t                learned = report.baselinemA[1];
+  passed &= cubigel.readHealth(0) == 0 && learned >= 3200 && learned < 3264;  // Jitter 0-63 mA
+  passed &= report.baselinemA[0] == 0 && report.baselinemA[2] == 0;
+  compressor.setRunning(2500, 4200);  // Draws 30% more
+  run(20);
+  uint8_t current   = cubigel.readHealth(0, false);
+  report            = cubigel.readHealthReport(0);
+  int16_t deviation = report.deviationmA;
+  passed &= current == CUBIGEL_HEALTH_CURRENT && report.baselinemA[1] == learned;
+  passed &= deviation > 900 && deviation < 1100;
+  compressor.setRunning(2500, 3200);  // Back to normal, the flag is kept until it is read
+  run(100);                           // and the run is long enough not to be a short cycle
+  passed &= cubigel.readHealth(0) == CUBIGEL_HEALTH_CURRENT && cubigel.readHealth(0) == 0;
+  for (uint8_t i = 0; i < 4; ++i) {  // Failed starts
+    compressor.setRunning(0, 0);
+    run(30);
+    compressor.setRunning(2000, 2500);
+    run(3);
+  }  // of for-next each failed start
+  compressor.setRunning(0, 0);
+  run(30);
+  report         = cubigel.readHealthReport(0);
+  uint8_t starts = cubigel.readHealth(0);
+  passed &= starts == CUBIGEL_HEALTH_STARTS && report.startScore == 4;
+  for (uint8_t i = 0; i < 3; ++i) {  // Short cycles, each one a successful start
+    compressor.setRunning(2500, 3200);
+    run(60);
+    compressor.setRunning(0, 0);
+    run(60);
+  }  // of for-next each short cycle
+  report         = cubigel.readHealthReport(0);
+  uint8_t cycles = cubigel.readHealth(0);
+  passed &= cycles == (CUBIGEL_HEALTH_STARTS | CUBIGEL_HEALTH_CYCLING);  // Starts until the first
+  passed &= report.cycleScore == 3 && report.startScore == 0;            // short cycle ended
+  passed &= cubigel.readHealth(0, false) == CUBIGEL_HEALTH_CYCLING;
+  compressor.setRunning(0, 0, 3);  // An alarm while off
+  run(5);
+  uint8_t alarm = cubigel.readHealth(0);
+  passed &= alarm == (CUBIGEL_HEALTH_CYCLING | CUBIGEL_HEALTH_ALARM);
+  cubigel.resetHealth(0);
+  report = cubigel.readHealthReport(0);
+  passed &= report.baselinemA[1] == 0 && report.cycleScore == 0 && cubigel.readHealth(0) == 0;
+  printf("Health test, learned %u mA at 2500 RPM, flags %02X on +1000 mA (%d mA off), %02X after "
+         "4 failed starts, %02X after 3 short cycles, %02X with an alarm\n",
+         learned, current, deviation, starts, cycles, alarm);
+  return passed;
+}  // of function healthTest()
+
+static bool instanceTest() {
+  /*!
+    @brief     Read a fridge and a freezer from two separate banks, with a third bank added and
+               destroyed in between, and check that the timer interrupt reads both of them
+    @return    true when both banks decoded the sentences sent to them
+  */
+  HardwareSerial   fridgePort, freezerPort, sparePort;
+  CubigelSimulator fridge(fridgePort, 5), freezer(freezerPort, 6), spare(sparePort, 7);
+  CubigelBank<1>   fridgeBank, freezerBank;  // Separate instances, e.g. in different modules
+  uint16_t         rpm, mA, spareReadings;
+  freezer.setRunning(3000, 4000);
+  fridgeBank.addDevice(&fridgePort);
+  {                                          // A bank which only exists for a while
+    CubigelBank<1> spareBank;
+    spareBank.addDevice(&sparePort);
+    for (uint16_t ms = 0; ms < 2000; ++ms) {
+      spare.update();
+      CubigelClass::TimerISR();
+      CubigelHost::advance(1);
+    }  // of for-next each simulated millisecond
+    spareReadings = spareBank.readValues(0, rpm, mA);
+  }  // of the spare bank's lifetime, it must leave the timer list
+  freezerBank.addDevice(&freezerPort);
+  for (uint16_t ms = 0; ms < 10000; ++ms) {
+    fridge.update();
+    freezer.update();
+    CubigelClass::TimerISR();
+    CubigelHost::advance(1);
+  }  // of for-next each simulated millisecond
+  uint16_t fridgeRPM, fridgemA, freezerRPM, freezermA;
+  uint16_t fridgeReadings  = fridgeBank.readValues(0, fridgeRPM, fridgemA);
+  uint16_t freezerReadings = freezerBank.readValues(0, freezerRPM, freezermA);
+  printf("Instance test, fridge bank %u readings at %u RPM, freezer bank %u readings at %u RPM, "
+         "spare bank %u readings\n",
+         fridgeReadings, fridgeRPM, freezerReadings, freezerRPM, spareReadings);
+  return fridgeReadings >= 18 && freezerReadings >= 18 && spareReadings >= 2 &&
+         fridgeRPM >= 2500 && fridgeRPM < 2532 && freezerRPM >= 3000 && freezerRPM < 3032;
+}  // of function instanceTest()
+
+static bool varianceTest() {
+  /*!
+    @brief     Start a simulated compressor with a current spike and check that the variance over
+               the next 10 minutes matches the one worked out from the history samples
+    @details   The sum of squares starts relative to the spike, which on its own would fill it after
+               about a dozen readings. Moving it to the average as the readings come in keeps it
+               from filling, and the variance must be within 2% of the samples' one, which have the
+               current rounded down to whole mA
+    @return    true when the sum didn't fill and the variance is close enough
+  */
+  HardwareSerial    port;
+  CubigelSimulator  compressor(port, 5);
+  CubigelBank<1>    cubigel;
+  CubigelSampleType history[8], samples[8];  // History ring buffer and batch
+  double            sum = 0, squares = 0;    // Sums of the sampled currents while running
+  uint32_t          count = 0;               // Running samples
+  auto              addBatch = [&]() {       // Add the waiting samples to the sums
+    uint8_t read = cubigel.readHistory(0, samples, 8);
+    for (uint8_t i = 0; i < read; ++i) {
+      if (!samples[i].RPM) continue;
+      sum     += samples[i].mA;
+      squares += (double)samples[i].mA * samples[i].mA;
+      ++count;
+    }  // of for-next each sample
+  };   // of lambda addBatch()
+  cubigel.addDevice(&port);
+  cubigel.setHistory(0, history, 8);
+  compressor.setRunning(2500, 9000);                    // Starts with a spike
+  for (uint32_t ms = 0; ms < 601000; ++ms) {            // for about a second, then runs for
+    if (ms == 1000) compressor.setRunning(2500, 3200);  // just over 10 minutes
+    compressor.update();
+    CubigelClass::TimerISR();
+    CubigelHost::advance(1);
+    if (ms % 2000 == 0) addBatch();  // Read a batch every 2 seconds
+  }                                  // of for-next each simulated millisecond
+  addBatch();                        // and what is left
+  CubigelSummaryType summary  = cubigel.readStatistics(0);
+  double             expected = count ? squares / count - (sum / count) * (sum / count) : 0;
+  printf("Variance test, %u running readings, %u mA-%u mA, variance %u mA^2 (samples %.0f)%s\n",
+         summary.running, summary.minmA, summary.maxmA, (unsigned)summary.variancemA, expected,
+         summary.saturated ? ", saturated" : "");
+  return !summary.saturated && summary.running == count && summary.maxmA >= 9000 &&
+         summary.variancemA >= expected * 0.98 && summary.variancemA <= expected * 1.02;
+}  // of function varianceTest()
+
+static void throughputTest(const Options &options) {
+  /*!
+    @brief     Feed sentences to the decoder as fast as it will accept them and report the speed
+    @param[in] options Command line options
+  */
+  HardwareSerial   port(BLOCK_SENTENCES * SIM_SENTENCE_MAX);  // Large enough for a whole block
+  CubigelSimulator compressor(port, 3);
+  compressor.setFaultRates(options.faultRate, options.faultRate, options.faultRate,
+                           options.faultRate);
+  CubigelBank<1> cubigel(options.pollMillis ? CUBIGEL_POLLED : CUBIGEL_TIMER);
+  cubigel.addDevice(&port);
+  while (port.transmitted() >= 0) {}  // Discard the mode command sent by addDevice()
+  uint64_t bytes = 0, decoded = 0, commsTotal = 0, cycles = 0, nanoseconds = 0, sent76 = 0;
+  uint8_t  sentence[SIM_SENTENCE_MAX];
+  for (uint32_t done = 0; done < options.sentences; done += BLOCK_SENTENCES) {
+    for (uint16_t i = 0; i < BLOCK_SENTENCES; ++i) {  // Fill the port with a block
+      compressor.setSettingsMode(options.settingsEvery && (done + i) % options.settingsEvery == 0);
+      CubigelSimulatorFault fault;
+      uint8_t               length = compressor.nextSentence(sentence, fault);
+      if (fault == SIM_OK && !compressor.settingsMode()) ++sent76;  // Count good type 76
+      for (uint8_t j = 0; j < length; ++j) port.inject(sentence[j]);
+      bytes += length;
+    }  // of for-next each sentence in the block
+    uint32_t startMicros = micros();
+    uint64_t startCycles = BENCH_CYCLES();
+    if (cubigel.polled()) {
+      cubigel.poll();  // Decode the whole block in one batch
+    } else {
+      while (port.available()) CubigelClass::TimerISR();  // Decode it a tick at a time
+    }                                                     // of if-then-else polled mode
+    cycles += BENCH_CYCLES() - startCycles;
+    nanoseconds += (uint64_t)(micros() - startMicros) * 1000;
+    while (port.transmitted() >= 0) {}  // Discard mode commands after type 80 sentences
+    uint16_t rpm, mA, commsErrors, errorStatus;
+    decoded += cubigel.readValues(0, rpm, mA, commsErrors, errorStatus);
+    commsTotal += commsErrors;
+  }  // of for-next each block
+  double seconds = nanoseconds / 1e9;
+  printf("Throughput test, %llu bytes in %.3f s\n", (unsigned long long)bytes, seconds);
+  printf("  %.0f bytes/s, %.0f sentences/s, %.1f ns/byte", bytes / seconds,
+         options.sentences / seconds, nanoseconds / (double)bytes);
+  if (cycles) printf(", %.1f cycles/byte", cycles / (double)bytes);
+  printf("\n  %llu of %llu good type 76 sentences decoded, %llu comms errors counted\n",
+         (unsigned long long)decoded, (unsigned long long)sent76, (unsigned long long)commsTotal);
+  printf("  %u ticks left bytes unread because of the burst limit\n", cubigel.readBudgetHits());
+  uint8_t                 record[CUBIGEL_TELEMETRY_BYTES];  // Pack and decode telemetry records
+  CubigelTelemetryDecoder decoder;
+  CubigelTelemetryRecord  telemetry;
+  uint32_t                records     = options.sentences / 10;
+  uint32_t                startMicros = micros();
+  for (uint32_t i = 0; i < records; ++i) {
+    uint8_t packed = cubigel.packTelemetry(0, record, sizeof(record), false);
+    for (uint8_t j = 0; j < packed; ++j) decoder.decode(record[j], telemetry);
+  }  // of for-next each record
+  seconds = (micros() - startMicros) / 1e6;
+  printf("  %.0f telemetry records/s packed and decoded, %u of %u good\n", records / seconds,
+         (unsigned)decoder.records(), (unsigned)records);
+}  // of function throughputTest()
+
+int main(int argc, char *argv[]) {
+  /*!
+    @brief     Program entry point
+    @param[in] argc Number of arguments
+    @param[in] argv Arguments, see usage text
+    @return    0 when the paced test passed, otherwise 1
+  */
+  Options options;
+  for (int i = 1; i + 1 < argc; i += 2) {  // Process "-x value" pairs
+    if (argv[i][0] == '-' && argv[i][1] == 'n') options.sentences = atoi(argv[i + 1]);
+    else if (argv[i][0] == '-' && argv[i][1] == 'f') options.faultRate = atoi(argv[i + 1]);
+    else if (argv[i][0] == '-' && argv[i][1] == 's') options.settingsEvery = atoi(argv[i + 1]);
+    else if (argv[i][0] == '-' && argv[i][1] == 't') options.seconds = atoi(argv[i + 1]);
+    else if (argv[i][0] == '-' && argv[i][1] == 'p') options.pollMillis = atoi(argv[i + 1]);
+    else if (argv[i][0] == '-' && argv[i][1] == 'e') options.eventDriven = atoi(argv[i + 1]);
+    else if (argv[i][0] == '-' && argv[i][1] == 'w') options.softwareSerial = atoi(argv[i + 1]);
+    else {
+      printf("Usage: %s [-n sentences] [-f faults/10000] [-s settings every n] [-t seconds] "
+             "[-p poll ms] [-e 0|1] [-w 0|1]\n",
+             argv[0]);
+      return 1;
+    }  // of if-then-else each option
+  }    // of for-next each option pair
+  printf("Memory per device on this host: %u bytes (%u hot, %u parser, %u settings)\n",
+         CUBIGEL_DEVICE_BYTES, (unsigned)sizeof(CubigelDataType), (unsigned)sizeof(CubigelParser),
+         (unsigned)sizeof(CubigelSettingsType));
+  bool passed = pacedTest(options);
+  passed &= healthTest();
+  passed &= instanceTest();
+  passed &= varianceTest();
+  printf("  %s\n", passed ? "PASSED" : "FAILED");
+  throughputTest(options);
+  return passed ? 0 : 1;
+}  // of function main()
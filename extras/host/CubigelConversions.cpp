@@ -0,0 +1,69 @@
+// clang-format off
+/*! @file CubigelConversions.cpp
+
+@brief Host program checking the Cubigel fixed-point conversions against the division they replace
+
+@section CubigelConversions_section Description
+
+The library converts the raw FDC1 current and voltage values with "cubigelmA()" and
+"cubigelMillivolts()", which multiply by a reciprocal and shift rather than divide. This program
+runs both conversions over every 16 bit input and compares them with "raw * 1000 / 3160" and
+"raw * 1000 / 1187". It also reports how far off the multiply and shift estimate would be without
+the correction step, which is the error bound given in "Cubigel.h". The program returns 1 if any
+converted value differs from the division.
+
+@section CubigelConversionsLicense License
+
+This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+General Public License as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version. This program is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details. You should have
+received a copy of the GNU General Public License along with this program.  If not, see
+<http://www.gnu.org/licenses/>.
+*/
+// clang-format on
+
+#include <stdio.h>    // printf()
+#include "Cubigel.h"  // Library and host shim definitions
+
+template <uint16_t SCALE, uint16_t RAW>
+static bool check(const char *name, uint16_t (*convert)(const uint16_t)) {
+  /*!
+    @brief     Compare a conversion with the division for every 16 bit input
+    @param[in] name    Name shown in the report
+    @param[in] convert Library conversion function
+    @return    true if every result is identical
+  */
+  constexpr uint16_t num        = SCALE / cubigelGcd(SCALE, RAW);  // Same reduced fraction and
+  constexpr uint16_t den        = RAW / cubigelGcd(SCALE, RAW);    // reciprocal as cubigelScale()
+  constexpr uint16_t multiplier = ((uint32_t)num << 16) / den;     //
+  uint32_t           mismatches = 0;                               // Results unlike the division
+  uint32_t           corrected  = 0;                               // Estimates needing correction
+  uint32_t           worst      = 0;                               // Largest estimate error
+  for (uint32_t raw = 0; raw <= 0xFFFF; ++raw) {
+    uint32_t exact    = raw * SCALE / RAW;            // Reference result
+    uint32_t estimate = (raw * multiplier) >> 16;     // Before the correction step
+    if (exact - estimate > worst) worst = exact - estimate;
+    if (estimate != exact) ++corrected;
+    if (convert((uint16_t)raw) != exact) {
+      if (mismatches++ < 5) printf("  %s(%u) = %u, expected %u\n", name, raw, convert(raw), exact);
+    }  // of if-then the conversion is wrong
+  }    // of for-next every 16 bit value
+  printf("%-18s x%u/%u as x%u/%u, multiplier %u: estimate up to %u low (%u of 65536 corrected), "
+         "%u mismatches\n",
+         name, SCALE, RAW, num, den, multiplier, worst, corrected, mismatches);
+  return mismatches == 0;
+}  // of function check()
+
+int main() {
+  /*!
+    @brief   Check both conversions used by the library
+    @return  0 if all results match the division, otherwise 1
+  */
+  bool passed = check<CUBIGEL_MA_SCALE, CUBIGEL_MA_RAW>("cubigelmA", cubigelmA);
+  passed      = check<CUBIGEL_MV_SCALE, CUBIGEL_MV_RAW>("cubigelMillivolts", cubigelMillivolts) &&
+           passed;
+  printf("%s\n", passed ? "PASSED" : "FAILED");
+  return passed ? 0 : 1;
+}  // of function main()
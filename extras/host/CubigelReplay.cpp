@@ -0,0 +1,227 @@
+/***************************************************************************************************
+** Host replay driver for raw captures made with CubigelClass::setCapture(). See the "README.md"  **
+** file in this directory for instructions on how to compile and run it.                          **
+** This program is free software: you can redistribute it and/or modify it under the terms of the **
+** GNU General Public License as published by the Free Software Foundation, either version 3 of   **
+** the License, or (at your option) any later version. This program is distributed in the hope    **
+** that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of         **
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for   **
+** more details. You should have received a copy of the GNU General Public License along with     **
+** this program.  If not, see <http://www.gnu.org/licenses/>.                                     **
+**                                                                                                **
+***************************************************************************************************/
+#include <stdio.h>   // printf(), fopen()
+#include <stdlib.h>  // atoi()
+#include <string.h>  // strcmp()
+
+#include "Cubigel.h"           // Cubigel library
+#include "CubigelSimulator.h"  // Simulated compressor
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>             // __rdtsc() for cycle counts
+  #define REPLAY_CYCLES() __rdtsc()  ///< Read the CPU time stamp counter
+#else
+  #define REPLAY_CYCLES() 0  ///< No cycle counter available
+#endif
+
+const uint8_t  REPLAY_DEVICES{4};            ///< Most devices in a capture
+const uint32_t REPLAY_MAX_ENTRIES{1000000};  ///< Most bytes in a capture
+const uint8_t  REPLAY_BATCH{128};            ///< Capture entries read per readCapture() call
+const uint8_t  REPLAY_RING{255};             ///< Entries in the library's capture ring buffer
+const char *   kStatusNames[] = {"busy", "values", "settings", "bad start", "bad type",
+                              "bad checksum"};  ///< CubigelParseStatus names
+
+static CubigelCaptureType capture[REPLAY_MAX_ENTRIES];  ///< Capture being recorded or replayed
+
+static uint32_t record(const uint32_t seconds, const uint16_t faultRate) {
+  /*!
+    @brief     Make a capture of two simulated compressors with corrupted sentences, read by the
+               timer interrupt, so that there is something to replay without a real recording
+    @param[in] seconds   Simulated seconds to record
+    @param[in] faultRate Faults of each type per 10000 sentences
+    @return    Number of entries captured
+  */
+  HardwareSerial     fridgePort, freezerPort;
+  CubigelSimulator   fridge(fridgePort, 1), freezer(freezerPort, 2);
+  CubigelBank<2>     cubigel;
+  CubigelCaptureType ring[REPLAY_RING];  // Capture ring buffer
+  uint32_t           count = 0;          // Entries captured
+  fridge.setFaultRates(faultRate, faultRate, faultRate, faultRate);
+  freezer.setFaultRates(faultRate, faultRate, faultRate, faultRate);
+  freezer.setRunning(0, 0, 4);
+  cubigel.setCapture(ring, REPLAY_RING);
+  cubigel.addDevice(&fridgePort);
+  cubigel.addDevice(&freezerPort);
+  cubigel.setSettingsRefresh(20);
+  for (uint32_t ms = 0; ms < seconds * 1000; ++ms) {  // Every simulated millisecond
+    fridge.update();
+    freezer.update();
+    CubigelClass::TimerISR();
+    CubigelHost::advance(1);
+    if (ms % 50 == 0 && count + REPLAY_BATCH <= REPLAY_MAX_ENTRIES) {  // Empty the ring buffer
+      count += cubigel.readCapture(capture + count, REPLAY_BATCH);
+    }  // of if-then time to read the capture
+  }    // of for-next each simulated millisecond
+  count += cubigel.readCapture(capture + count, REPLAY_BATCH);
+  if (cubigel.readCaptureDropped()) printf("Capture buffer overflowed, bytes were lost\n");
+  return count;
+}  // of function record()
+
+static bool replay(const uint32_t count) {
+  /*!
+    @brief     Feed a capture through the library at the recorded times, as fast as possible, and
+               check that the parser returns the same status for every byte as when it was
+               recorded. The bytes of different devices read in the same millisecond may be in a
+               different order, so each device's bytes are compared with its own recorded ones
+    @param[in] count Number of entries in the capture
+    @return    true when every status matched
+  */
+  uint8_t devices = 0;  // Devices in the capture
+  for (uint32_t i = 0; i < count; ++i) {
+    if (capture[i].device >= devices) devices = capture[i].device + 1;
+  }  // of for-next each entry
+  if (devices > REPLAY_DEVICES) {
+    printf("The capture has %u devices, only %u are supported\n", devices, REPLAY_DEVICES);
+    return false;
+  }  // of if-then too many devices
+  HardwareSerial *ports[REPLAY_DEVICES];
+  CubigelBank<REPLAY_DEVICES> cubigel(CUBIGEL_POLLED);
+  CubigelCaptureType ring[REPLAY_RING], replayed[REPLAY_BATCH];  // Capture of the replay
+  if (count) CubigelHost::clock() = capture[0].time;
+  for (uint8_t idx = 0; idx < devices; ++idx) {
+    ports[idx] = new HardwareSerial(REPLAY_MAX_ENTRIES);  // Never overflows
+    cubigel.addDevice(ports[idx]);
+  }  // of for-next each device
+  cubigel.setCapture(ring, REPLAY_RING);
+  uint32_t checked = 0, mismatches = 0, statuses[CUBIGEL_PARSE_BAD_CHECKSUM + 1] = {0};
+  uint32_t next[REPLAY_DEVICES] = {0};  // Next recorded entry of each device to compare with
+  uint64_t cycles      = 0;
+  uint32_t startMicros = micros();
+  for (uint32_t i = 0; i <= count; ++i) {
+    if (i == count || capture[i].time != millis()) {  // Decode the bytes of one millisecond
+      uint64_t start = REPLAY_CYCLES();
+      cubigel.poll();
+      cycles += REPLAY_CYCLES() - start;
+      uint8_t got;
+      while ((got = cubigel.readCapture(replayed, REPLAY_BATCH)) > 0) {  // Compare with the
+        for (uint8_t j = 0; j < got; ++j, ++checked) {                   // recorded statuses
+          uint32_t &entry = next[replayed[j].device];
+          while (entry < count && capture[entry].device != replayed[j].device) ++entry;
+          ++statuses[replayed[j].status];
+          if (entry == count) {  // More bytes than were recorded, which can't happen
+            ++mismatches;
+            continue;
+          }  // of if-then no recorded byte left
+          const CubigelCaptureType &original = capture[entry++];  // Device's next recorded byte
+          if (replayed[j].value != original.value || replayed[j].status != original.status) {
+            if (mismatches++ < 5) {
+              printf("  Byte %u at %u ms, device %u: %s when recorded, %s now\n",
+                     (unsigned)(entry - 1), (unsigned)original.time, original.device,
+                     kStatusNames[original.status], kStatusNames[replayed[j].status]);
+            }  // of if-then show the first few
+          }    // of if-then the status changed
+        }      // of for-next each replayed byte
+      }        // of while-loop replayed bytes waiting
+      if (i == count) break;
+      CubigelHost::clock() = capture[i].time;  // Move on to the next byte's time
+    }                                          // of if-then the time changes
+    ports[capture[i].device]->inject(capture[i].value);
+  }  // of for-next each entry
+  double seconds = (micros() - startMicros) / 1e6;
+  printf("Replayed %u bytes from %u devices in %.3f s, %.0f bytes/s", (unsigned)count, devices,
+         seconds, count / seconds);
+  if (cycles && count) printf(", %.1f cycles/byte decoding", cycles / (double)count);
+  printf("\n  Parser results:");
+  for (uint8_t s = CUBIGEL_PARSE_BUSY; s <= CUBIGEL_PARSE_BAD_CHECKSUM; ++s) {
+    printf(" %u %s%s", (unsigned)statuses[s], kStatusNames[s],
+           s < CUBIGEL_PARSE_BAD_CHECKSUM ? "," : "\n");
+  }  // of for-next each status
+  for (uint8_t idx = 0; idx < devices; ++idx) {
+    uint16_t rpm, mA, commsErrors, errorStatus;
+    uint16_t readings = cubigel.readValues(idx, rpm, mA, commsErrors, errorStatus);
+    printf("  Device %u: %u readings, %u RPM, %u mA, %u comms errors, alarms %u\n", idx, readings,
+           rpm, mA, commsErrors, errorStatus);
+    delete ports[idx];
+  }  // of for-next each device
+  printf("  %u of %u bytes replayed with the recorded result\n", (unsigned)(checked - mismatches),
+         (unsigned)count);
+  return checked == count && mismatches == 0;
+}  // of function replay()
+
+static uint32_t load(const char *name) {
+  /*!
+    @brief     Read a capture file, one "time device value status" line per byte
+    @param[in] name File name
+    @return    Number of entries read
+  */
+  FILE *file = fopen(name, "r");
+  if (file == nullptr) {
+    printf("Can't open %s\n", name);
+    return 0;
+  }  // of if-then file not found
+  uint32_t count = 0;
+  unsigned long time;
+  unsigned      device, value, status;
+  while (count < REPLAY_MAX_ENTRIES &&
+         fscanf(file, "%lu %u %u %u", &time, &device, &value, &status) == 4) {
+    capture[count].time   = time;
+    capture[count].device = device;
+    capture[count].value  = value;
+    capture[count].status = status <= CUBIGEL_PARSE_BAD_CHECKSUM ? status : 0;  // Busy if unknown
+    ++count;
+  }  // of while-loop each line
+  fclose(file);
+  return count;
+}  // of function load()
+
+static void save(const char *name, const uint32_t count) {
+  /*!
+    @brief     Write a capture file in the format read by load()
+    @param[in] name  File name
+    @param[in] count Number of entries
+  */
+  FILE *file = fopen(name, "w");
+  if (file == nullptr) {
+    printf("Can't create %s\n", name);
+    return;
+  }  // of if-then file not created
+  for (uint32_t i = 0; i < count; ++i) {
+    fprintf(file, "%lu %u %u %u\n", (unsigned long)capture[i].time, capture[i].device,
+            capture[i].value, capture[i].status);
+  }  // of for-next each entry
+  fclose(file);
+}  // of function save()
+
+int main(int argc, char *argv[]) {
+  /*!
+    @brief     Program entry point
+    @param[in] argc Number of arguments
+    @param[in] argv Arguments, see usage text
+    @return    0 when every replayed byte gave the recorded result, otherwise 1
+  */
+  const char *readName = nullptr, *writeName = nullptr;
+  uint32_t    seconds = 600;
+  uint16_t    faultRate = 50;
+  for (int i = 1; i + 1 < argc; i += 2) {  // Process "-x value" pairs
+    if (!strcmp(argv[i], "-r")) readName = argv[i + 1];
+    else if (!strcmp(argv[i], "-w")) writeName = argv[i + 1];
+    else if (!strcmp(argv[i], "-t")) seconds = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "-f")) faultRate = atoi(argv[i + 1]);
+    else {
+      printf("Usage: %s [-r capture file] [-w capture file] [-t seconds] [-f faults/10000]\n",
+             argv[0]);
+      return 1;
+    }  // of if-then-else each option
+  }    // of for-next each option pair
+  uint32_t count;
+  if (readName) {
+    count = load(readName);
+    printf("Read %u bytes from %s\n", (unsigned)count, readName);
+  } else {
+    count = record(seconds, faultRate);
+    printf("Recorded %u bytes in %u simulated seconds\n", (unsigned)count, (unsigned)seconds);
+  }  // of if-then-else read or record a capture
+  if (writeName) save(writeName, count);
+  bool passed = replay(count);
+  printf("  %s\n", passed ? "PASSED" : "FAILED");
+  return passed ? 0 : 1;
+}  // of function main()
@@ -0,0 +1,230 @@
+// clang-format off
+/*! @file CubigelSimulator.h
+
+@brief Simulated Cubigel compressor with an FDC1 controller for host builds of the library
+
+@section CubigelSimulator_section Description
+
+The simulator generates type 76 (speed and current) and type 80 (settings) sentences into one of
+the in-memory serial ports from "CubigelHost.h". It listens to the 7 byte mode command which the
+library sends and switches between the two sentence types just as the real controller does. A
+configurable fraction of the sentences can be corrupted (bad start byte, unknown sentence type, bad
+checksum or a dropped byte) so that the error handling in the library can be exercised.
+
+"update()" paces the output at the real 1200 baud rate and sentence interval against the simulated
+millis() clock, while "nextSentence()" just builds the next sentence into a buffer so that the
+benchmark can feed data as fast as the decoder accepts it.
+
+@section CubigelSimulatorLicense License
+
+This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+General Public License as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version. This program is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details. You should have
+received a copy of the GNU General Public License along with this program.  If not, see
+<http://www.gnu.org/licenses/>.
+*/
+// clang-format on
+
+#ifndef CubigelSimulator_h                 // Guard code definition
+  #define CubigelSimulator_h               ///< Define the name inside guard code
+  #include "Cubigel.h"                     // Library and host shim definitions
+const uint8_t  SIM_SENTENCE_MAX{22};       ///< Longest sentence (type 80)
+const uint16_t SIM_BYTE_MILLIS_X100{833};  ///< 1/100ths of a ms per byte at 1200 baud 8N1
+/*! @brief Types of corruption the simulator can apply to a sentence */
+enum CubigelSimulatorFault { SIM_OK, SIM_BAD_START, SIM_BAD_TYPE, SIM_BAD_CHECKSUM, SIM_DROP_BYTE };
+
+class CubigelSimulator {
+  /*!
+   * @class CubigelSimulator
+   * @brief Simulated compressor connected to a host serial port
+   */
+ public:
+  CubigelSimulator(CubigelHostSerial &port, const uint32_t seed = 1) : _port(port), _seed(seed) {
+    /*!
+      @brief     Class constructor
+      @param[in] port Host serial port that the library reads from
+      @param[in] seed Seed for the pseudo random corruption and value generator
+    */
+  }  // of constructor
+  void setRunning(const uint16_t rpm, const uint16_t mA, const uint8_t alarm = 0) {
+    /*!
+      @brief     Set the values sent in type 76 sentences
+      @param[in] rpm   Compressor speed, 0 means the compressor is off
+      @param[in] mA    Current consumption in milliamps
+      @param[in] alarm Alarm code sent while the compressor is off
+    */
+    _rpm   = rpm;
+    _mA    = mA;
+    _alarm = alarm;
+  }  // of method setRunning()
+  void setSettings(const uint16_t minSpeed, const uint16_t maxSpeed, const uint8_t mode) {
+    /*!
+      @brief     Set the speed range and mode switches sent in type 80 sentences
+      @param[in] minSpeed Minimum compressor speed
+      @param[in] maxSpeed Maximum compressor speed
+      @param[in] mode     Mode switch byte
+    */
+    _minSpeed = minSpeed;
+    _maxSpeed = maxSpeed;
+    _mode     = mode;
+  }  // of method setSettings()
+  void setFaultRates(const uint16_t badStart, const uint16_t badType, const uint16_t badChecksum,
+                     const uint16_t dropByte) {
+    /*!
+      @brief     Set how often each fault is injected, in sentences per 10000
+      @param[in] badStart    Sentences starting with something other than 27
+      @param[in] badType     Sentences with an unknown type byte
+      @param[in] badChecksum Sentences with a corrupted checksum
+      @param[in] dropByte    Sentences with one data byte missing
+    */
+    _faultRate[SIM_BAD_START]    = badStart;
+    _faultRate[SIM_BAD_TYPE]     = badType;
+    _faultRate[SIM_BAD_CHECKSUM] = badChecksum;
+    _faultRate[SIM_DROP_BYTE]    = dropByte;
+  }  // of method setFaultRates()
+  void setInterval(const uint16_t milliseconds) { _interval = milliseconds; }  ///< Sentence rate
+  void setSettingsMode(const bool settings) { _settingsMode = settings; }    ///< Force mode
+  bool settingsMode() const { return _settingsMode; }  ///< true when sending type 80 sentences
+  uint8_t nextSentence(uint8_t *buffer, CubigelSimulatorFault &fault) {
+    /*!
+      @brief      Build the next sentence, possibly corrupted, into the buffer
+      @param[out] buffer Storage for at least SIM_SENTENCE_MAX bytes
+      @param[out] fault  Fault that was applied to the sentence
+      @return     Number of bytes in the sentence
+    */
+    uint8_t length = _settingsMode ? buildSettings(buffer) : buildValues(buffer);
+    fault          = SIM_OK;
+    uint16_t roll  = random() % 10000;  // Decide which fault, if any, to use
+    for (uint8_t i = SIM_BAD_START; i <= SIM_DROP_BYTE; ++i) {
+      if (roll < _faultRate[i]) {
+        fault = (CubigelSimulatorFault)i;
+        break;
+      }  // of if-then this fault was chosen
+      roll -= _faultRate[i];
+    }  // of for-next each fault type
+    switch (fault) {
+      case SIM_BAD_START: buffer[0] = 26; break;
+      case SIM_BAD_TYPE: buffer[1] = 77; break;
+      case SIM_BAD_CHECKSUM: buffer[length - 1] ^= 0x5A; break;
+      case SIM_DROP_BYTE:
+        memmove(buffer + 3, buffer + 4, length - 4);  // Lose the 4th byte
+        --length;
+        break;
+      default: break;
+    }  // of switch the fault type
+    ++_sentences[fault];
+    return length;
+  }  // of method nextSentence()
+  void update() {
+    /*!
+      @brief   Called as often as possible by the host program. Listens for mode commands from the
+               library and writes sentence bytes into the port at 1200 baud, one sentence every
+               interval, using the simulated millis() clock
+    */
+    int value;
+    while ((value = _port.transmitted()) >= 0) {  // Check for a mode command
+      _command[_commandIndex++] = (uint8_t)value;
+      if (_commandIndex == 1 && value != 72) _commandIndex = 0;  // Not a command start
+      if (_commandIndex == sizeof(_command)) {                   // Have a whole command
+        if (_command[1] == 80 && _command[6] == 15) _settingsMode = (_command[2] == 192);
+        _commandIndex = 0;
+      }  // of if-then we have a complete command
+    }    // of while-loop bytes transmitted by the library
+    uint32_t now = millis();
+    if (_pending == _length && (int32_t)(now - _nextSentence) >= 0) {  // Time for a new sentence
+      CubigelSimulatorFault fault;
+      _length       = nextSentence(_sentence, fault);
+      _pending      = 0;
+      _nextByte     = now * 100;
+      _nextSentence = now + _interval;
+    }  // of if-then time for the next sentence
+    while (_pending < _length && (int32_t)(now * 100 - _nextByte) >= 0) {  // Send at baud rate
+      _port.inject(_sentence[_pending++]);
+      _nextByte += SIM_BYTE_MILLIS_X100;
+    }  // of while-loop bytes due to be sent
+  }    // of method update()
+  uint32_t sentences(const CubigelSimulatorFault fault) const {
+    /*!
+      @brief     Return how many sentences were generated with the given fault
+      @param[in] fault Fault type, SIM_OK for good sentences
+      @return    Number of sentences
+    */
+    return _sentences[fault];
+  }  // of method sentences()
+
+ private:
+  uint32_t random() {
+    /*!
+      @brief   Simple linear congruential generator so that runs are repeatable
+      @return  Pseudo random number
+    */
+    _seed = _seed * 1103515245 + 12345;
+    return (_seed >> 16) & 0x7FFF;
+  }  // of method random()
+  uint8_t buildValues(uint8_t *buffer) {
+    /*!
+      @brief      Build a type 76 sentence. A little noise is added to the speed and current
+      @param[out] buffer Sentence storage
+      @return     Sentence length
+    */
+    uint16_t rpm = _rpm ? _rpm + random() % 32 : 0;                // Speed with some jitter
+    uint32_t raw = (uint32_t)(_mA + random() % 64) * 3160 / 1000;  // mA as sent by the FDC1
+    buffer[0]    = 27;
+    buffer[1]    = 76;
+    buffer[2]    = rpm >> 8;
+    buffer[3]    = rpm & 0xFF;
+    buffer[4]    = _rpm ? (uint8_t)(raw >> 8) : 0;
+    buffer[5]    = _rpm ? (uint8_t)(raw & 0xFF) : _alarm;
+    buffer[6]    = buffer[0] ^ buffer[2] ^ buffer[4];  // Even byte checksum
+    buffer[7]    = buffer[1] ^ buffer[3] ^ buffer[5];  // Odd byte checksum
+    return 8;
+  }  // of method buildValues()
+  uint8_t buildSettings(uint8_t *buffer) {
+    /*!
+      @brief      Build a type 80 sentence using 10.4/11.7V, 22.8/24.2V and 31.0/32.7V for the cut
+                  out and cut in voltages
+      @param[out] buffer Sentence storage
+      @return     Sentence length
+    */
+    static const uint16_t volts[6] = {10400, 11700, 22800, 24200, 31000, 32700};  // millivolts
+    buffer[0]                      = 27;
+    buffer[1]                      = 80;
+    buffer[2]                      = _minSpeed >> 8;
+    buffer[3]                      = _minSpeed & 0xFF;
+    buffer[4]                      = _maxSpeed >> 8;
+    buffer[5]                      = _maxSpeed & 0xFF;
+    buffer[6]                      = 0;
+    buffer[7]                      = _mode;
+    for (uint8_t i = 0; i < 6; ++i) {  // Voltages as sent by the FDC1
+      uint16_t raw      = (uint32_t)volts[i] * 1187 / 1000;
+      buffer[8 + i * 2] = raw >> 8;
+      buffer[9 + i * 2] = raw & 0xFF;
+    }                 // of for-next each voltage
+    buffer[20] = 72;  // Even checksum starts with 72 rather than 27
+    buffer[21] = 0;
+    for (uint8_t i = 1; i < 20; ++i) buffer[20 + (i & 1)] ^= buffer[i];
+    return 22;
+  }                                                        // of method buildSettings()
+  CubigelHostSerial &_port;                                // Port the library reads from
+  uint32_t           _seed;                                // Pseudo random generator state
+  uint16_t           _rpm      = 2500;                     // Type 76 speed
+  uint16_t           _mA       = 3200;                     // Type 76 current
+  uint8_t            _alarm    = 0;                        // Type 76 alarm code when off
+  uint16_t           _minSpeed = 2000;                     // Type 80 minimum speed
+  uint16_t           _maxSpeed = 3500;                     // Type 80 maximum speed
+  uint8_t            _mode     = 4;                        // Type 80 mode switches
+  uint16_t           _interval = 500;                      // Milliseconds between sentences
+  uint16_t           _faultRate[SIM_DROP_BYTE + 1] = {0};  // Faults per 10000 sentences
+  uint32_t           _sentences[SIM_DROP_BYTE + 1] = {0};  // Sentences generated per fault
+  bool               _settingsMode = false;                // Sending type 80 rather than 76
+  uint8_t            _command[7];                          // Mode command received from library
+  uint8_t            _commandIndex = 0;                    // Bytes of command received
+  uint8_t            _sentence[SIM_SENTENCE_MAX];          // Sentence being sent by update()
+  uint8_t            _length       = 0;                    // Length of sentence being sent
+  uint8_t            _pending      = 0;                    // Bytes of it sent so far
+  uint32_t           _nextByte     = 0;                    // When next byte is due, in 1/100 ms
+  uint32_t           _nextSentence = 0;                    // When the next sentence is due
+};  // of class CubigelSimulator
+#endif
@@ -0,0 +1,143 @@
+// clang-format off
+/*! @file CubigelTelemetry.h
+
+@brief Receiving side decoder for the binary records written by CubigelClass::packTelemetry()
+
+@section CubigelTelemetry_section Description
+
+A gateway reading one or more Arduinos over a serial link passes every byte it receives to
+"CubigelTelemetryDecoder::decode()", which returns true each time a complete record with a good
+CRC has arrived and fills in a "CubigelTelemetryRecord". Bytes in front of a sync byte, records
+with an unknown version or length and records with a bad CRC are skipped, and the decoder then
+looks for the next sync byte inside the bytes already received, so one lost or corrupted byte only
+costs the record it was in. The decoder only uses the constants and "cubigelCrc16()" from
+"Cubigel.h", so it can be copied into a gateway program which doesn't use the rest of the library.
+
+@section CubigelTelemetryLicense License
+
+This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+General Public License as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version. This program is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details. You should have
+received a copy of the GNU General Public License along with this program.  If not, see
+<http://www.gnu.org/licenses/>.
+*/
+// clang-format on
+
+#ifndef CubigelTelemetry_h                // Guard code definition
+  #define CubigelTelemetry_h              ///< Define the name inside guard code
+  #include "Cubigel.h"                    // Record constants and cubigelCrc16()
+/*! @brief  Contents of one decoded packTelemetry() record */
+struct CubigelTelemetryRecord {
+  uint8_t  device;        ///< Device index on the sending Arduino
+  uint32_t time;          ///< Sender's millis() when the record was made
+  uint32_t interval;      ///< Milliseconds covered by the statistics
+  uint16_t readings;      ///< Number of type 76 sentences read
+  uint16_t running;       ///< Number of those with the compressor running
+  uint16_t RPM;           ///< Average RPM while running
+  uint16_t minRPM;        ///< Lowest RPM
+  uint16_t maxRPM;        ///< Highest RPM
+  uint16_t mA;            ///< Average Milliamps while running
+  uint16_t minmA;         ///< Lowest Milliamps
+  uint16_t maxmA;         ///< Highest Milliamps
+  uint16_t commsErrors;   ///< Number of communications errors
+  uint8_t  errorStatus;   ///< OR'd Cubigel alarm codes
+  uint16_t dutyCycle;     ///< Running time in 1/100ths of a percent since the device was added
+  uint16_t cycles;        ///< Number of compressor starts since the device was added
+  uint32_t cycleSeconds;  ///< Mean length of a start to start cycle
+};  // of struct CubigelTelemetryRecord
+
+class CubigelTelemetryDecoder {
+  /*!
+   * @class CubigelTelemetryDecoder
+   * @brief Finds and checks packTelemetry() records in a stream of received bytes
+   */
+ public:
+  bool decode(const uint8_t value, CubigelTelemetryRecord &record) {
+    /*!
+      @brief      Pass the next received byte to the decoder
+      @param[in]  value  Received byte
+      @param[out] record Decoded record, only changed when true is returned
+      @return     true when the byte completed a record with a good CRC
+    */
+    _buffer[_count++] = value;
+    while (_count) {                                  // Until the buffer starts a possible record
+      if (_buffer[0] != CUBIGEL_TELEMETRY_SYNC) {     // Not a record start, so
+        resync();                                     // throw the byte away
+      } else if (_count >= 3 && (_buffer[1] != CUBIGEL_TELEMETRY_VERSION ||
+                                 _buffer[2] != CUBIGEL_TELEMETRY_BYTES)) {  // Not a known record
+        resync();
+      } else if (_count < CUBIGEL_TELEMETRY_BYTES) {  // Wait for the rest of the record
+        return false;
+      } else {                                        // Have a whole record, check the CRC
+        uint16_t crc = 0xFFFF;
+        for (uint8_t i = 0; i < CUBIGEL_TELEMETRY_BYTES - 2; ++i) {
+          crc = cubigelCrc16(crc, _buffer[i]);
+        }                                                    // of for-next each byte before the CRC
+        if (crc != readWord(CUBIGEL_TELEMETRY_BYTES - 2)) {  // Corrupted, resync inside it
+          ++_crcErrors;
+          resync();
+          continue;
+        }  // of if-then the CRC is wrong
+        record.device       = _buffer[3];
+        record.time         = readLong(4);
+        record.interval     = readLong(8);
+        record.readings     = readWord(12);
+        record.running      = readWord(14);
+        record.RPM          = readWord(16);
+        record.minRPM       = readWord(18);
+        record.maxRPM       = readWord(20);
+        record.mA           = readWord(22);
+        record.minmA        = readWord(24);
+        record.maxmA        = readWord(26);
+        record.commsErrors  = readWord(28);
+        record.errorStatus  = _buffer[30];
+        record.dutyCycle    = readWord(31);
+        record.cycles       = readWord(33);
+        record.cycleSeconds = readLong(35);
+        _count              = 0;
+        ++_records;
+        return true;
+      }  // of if-then-else the state of the buffer
+    }    // of while-loop bytes in the buffer
+    return false;
+  }                                                  // of method decode()
+  uint32_t records() const { return _records; }      ///< Good records decoded
+  uint32_t crcErrors() const { return _crcErrors; }  ///< Records rejected because of the CRC
+  uint32_t skipped() const { return _skipped; }      ///< Bytes discarded, incl. bad records
+
+ private:
+  void resync() {
+    /*!
+      @brief   Drop the first byte of the buffer and move up to the next sync byte, if any
+    */
+    uint8_t start = 1;
+    while (start < _count && _buffer[start] != CUBIGEL_TELEMETRY_SYNC) ++start;
+    _skipped += start;  // Count the bytes thrown away
+    memmove(_buffer, _buffer + start, _count - start);
+    _count -= start;
+  }  // of method resync()
+  uint16_t readWord(const uint8_t offset) const {
+    /*!
+      @brief     Read a little-endian 16 bit value from the buffer
+      @param[in] offset Position in the record
+      @return    Value
+    */
+    return _buffer[offset] | (uint16_t)_buffer[offset + 1] << 8;
+  }  // of method readWord()
+  uint32_t readLong(const uint8_t offset) const {
+    /*!
+      @brief     Read a little-endian 32 bit value from the buffer
+      @param[in] offset Position in the record
+      @return    Value
+    */
+    return readWord(offset) | (uint32_t)readWord(offset + 2) << 16;
+  }                                           // of method readLong()
+  uint8_t  _buffer[CUBIGEL_TELEMETRY_BYTES];  // Bytes of the record being received
+  uint8_t  _count     = 0;                    // Bytes in the buffer
+  uint32_t _records   = 0;                    // Good records decoded
+  uint32_t _crcErrors = 0;                    // Records with a bad CRC
+  uint32_t _skipped   = 0;                    // Bytes discarded
+};  // of class CubigelTelemetryDecoder
+#endif
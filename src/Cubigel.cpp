@@ -11,113 +11,188 @@
 **                                                                                                **
 ***************************************************************************************************/
 #include "Cubigel.h"  // Include the header file
+#if defined(__AVR__)
+  #include <util/atomic.h>  // ATOMIC_BLOCK() to guard the event queue
+#else
+  #define ATOMIC_RESTORESTATE                                          ///< Not needed, see below
+  #define ATOMIC_BLOCK(type) for (bool once = true; once; once = false)  ///< Only AVR boards read
+#endif  // ports from an interrupt, elsewhere everything runs in the foreground so needs no guard
 
-#include <SoftwareSerial.h>  // Include the software serial lib
-
-CubigelClass *CubigelClass::ClassPtr;  ///< Declare Class Reference pointer
+CubigelClass *volatile CubigelClass::_firstTimed = nullptr;  ///< Instances read by the timer
+#if defined(CUBIGEL_PROFILE)  // The timings are kept here so the class is the same without the flag
+  #if defined(ARDUINO)
+    #define CUBIGEL_PROFILE_CLOCK() micros()  ///< Clock used for the profile timings
+  #else
+    #define CUBIGEL_PROFILE_CLOCK() CubigelHost::nanos()  ///< Clock used for the profile timings
+  #endif
+static volatile uint32_t profileTicks    = 0;           ///< Timer ticks measured
+static volatile uint32_t profileBusy     = 0;           ///< Ticks which did something
+static volatile uint32_t profileMin      = UINT32_MAX;  ///< Shortest tick
+static volatile uint32_t profileMax      = 0;           ///< Longest tick
+static volatile uint32_t profileTotal    = 0;           ///< Sum of ticks for the mean, see below
+static volatile uint32_t profileSummed   = 0;           ///< Ticks in profileTotal
+static volatile uint32_t profileMaxByte  = 0;           ///< Longest processDevice() call
+static volatile uint32_t profileMaxOff   = 0;           ///< Longest interrupts off window
+static uint32_t          profileOffStart = 0;           ///< When interrupts were disabled
+static volatile bool     profileInTick   = false;       ///< The timer tick is being measured
+/*! @brief  times an ATOMIC_BLOCK from its first to its last statement and keeps the longest in
+            profileMaxOff. Blocks reached from the timer tick are skipped, interrupts are off for
+            the whole tick anyway and it is measured on its own */
+struct CubigelProfileOff {
+  uint32_t start = CUBIGEL_PROFILE_CLOCK();  ///< When the block was entered
+  ~CubigelProfileOff() {
+    uint32_t elapsed = CUBIGEL_PROFILE_CLOCK() - start;            // Time interrupts were off
+    if (!profileInTick && elapsed > profileMaxOff) profileMaxOff = elapsed;  // Keep the longest
+  }  // of destructor
+};   // of struct CubigelProfileOff
+  #define CUBIGEL_PROFILE_OFF() CubigelProfileOff profileOff  ///< Time the enclosing block
+#else
+  #define CUBIGEL_PROFILE_OFF()  ///< Nothing is timed without the flag
+#endif
 /***************************************************************************************************
-** The class constructor is overloaded to allow from 1 to CUBIGEL_MAX_DEVICES devices to be       **
-** monitored at the same time. Data is read using either the SoftwareSerial or the HardwareSerial **
-** calls, and each device needs to have been instantiated in order to pass in the appropriate     **
-** pointer to the SoftwareSerial instance.                                                        **
+** The class constructor is only called by CubigelBank<N>, which passes in the storage for its N  **
+** devices. Devices are then added one at a time using addDevice(). Data is read using the        **
+** "Stream" interface which both the SoftwareSerial and the HardwareSerial classes share, so the  **
+** serial port only needs to be started at the correct baud rate when it is added.                **
 ** The Arduino design method doesn't allow interrupts to be attached to class members. The        **
-** interrupt ISR is attached to the local static function, which in turn uses a pointer to the    **
-** class with an offset to the appropriate function to call the correct function.                 **
+** interrupt ISR is attached to the local static function, which in turn walks a linked list of   **
+** the instances with devices for the timer to read and calls each one's handler. An instance is  **
+** put on the list when the first device that the timer reads is added and the timer is started   **
+** with the first instance, so in polled mode or when all of the ports are event driven it is     **
+** left alone. Several instances can each own a group of compressors, e.g. in different modules.  **
 ****************************************************************************************************/
-CubigelClass::CubigelClass(SoftwareSerial *serial1) {
+CubigelClass::CubigelClass(volatile CubigelDataType *deviceStorage, CubigelParser *parserStorage,
+                           volatile CubigelSettingsType *settingsStorage, const uint8_t capacity,
+                           volatile CubigelEventType *eventStorage, const uint8_t eventSize,
+                           const uint8_t readMode)
+    : _capacity(capacity),
+#if defined(CUBIGEL_NO_TIMER)
+      _polled(true),  // There is no timer interrupt, so always poll
+#else
+      _polled(readMode == CUBIGEL_POLLED),
+#endif
+      _eventSize(eventSize),
+      events(eventStorage),
+      devices(deviceStorage),
+      parsers(parserStorage),
+      settings(settingsStorage) {
   /*!
-   * @brief     Constructor (overloaded) for one serial port
-   * @details   Point to appropriate software port
-   * @param[in] serial1 Pointer to software serial port
+   * @brief     Class constructor, called by CubigelBank<N>
+   * @details   The storage belongs to the CubigelBank and is not yet initialized when this is
+   *            called, so it must not be accessed here
+   * @param[in] deviceStorage Array of "capacity" device data structures
+   * @param[in] parserStorage Array of "capacity" parsers
+   * @param[in] settingsStorage Array of "capacity" settings structures
+   * @param[in] capacity      Number of devices that can be added
+   * @param[in] eventStorage  Array of "eventSize" events for the event queue
+   * @param[in] eventSize     Number of entries in the event queue
+   * @param[in] readMode      CUBIGEL_TIMER or CUBIGEL_POLLED
    */
-  ClassPtr            = this;                     // pointer to current instance
-  devices[0].serialSW = serial1;                  // point to the appropriate port
-  devices[0].serialSW->begin(CUBIGEL_BAUD_RATE);  // Set baud rate to Cubigel speed
-  _deviceCount = 1;                               // Store the number of devices
-  StartTimer();                                   // Enable timer interrupts
-  setMode(0, MODE_SETTINGS);                      // Retrieve settings on first call
+  (void)readMode;  // Not used when there is no timer
 }  // of class constructor
-CubigelClass::CubigelClass(HardwareSerial *serial1) {
+CubigelClass::~CubigelClass() {
   /*!
-   * @brief     Constructor (overloaded) for one serial port
-   * @details   Point to appropriate hardware port
-   * @param[in] serial1 Pointer to hardware serial port
+   * @brief     Class destructor, takes the instance off the list read by the timer interrupt
+   * @details   Banks are normally global and never destroyed, but one declared inside a function
+   *            must not be called by the interrupt once the function has returned. The timer
+   *            itself is left running, with nothing to do the interrupt returns straight away
    */
-  ClassPtr            = this;                     // pointer to current instance
-  devices[0].serialHW = serial1;                  // point to the appropriate port
-  devices[0].serialHW->begin(CUBIGEL_BAUD_RATE);  // Set baud rate to Cubigel speed
-  _deviceCount = 1;                               // Store the number of devices
-  StartTimer();                                   // Enable timer interrupts
-  setMode(0, MODE_SETTINGS);                      // Retrieve settings on first call
-}  // of class constructor
-CubigelClass::CubigelClass(HardwareSerial *serial1, SoftwareSerial *serial2) {
-  /*!
-    @brief     Constructor (overloaded) for a HW and a SW serial port
-    @details   Point to appropriate hardware and serial ports
-    @param[in] serial1 Pointer to hardware serial port
-    @param[in] serial2 Pointer to software serial port
-  */
-  ClassPtr            = this;                     // pointer to current instance
-  devices[0].serialHW = serial1;                  // point to the appropriate port
-  devices[0].serialHW->begin(CUBIGEL_BAUD_RATE);  // Set baud rate to Cubigel speed
-  devices[1].serialSW = serial2;                  // point to the appropriate port
-  devices[1].serialSW->begin(CUBIGEL_BAUD_RATE);  // Set baud rate to Cubigel speed
-  _deviceCount = 2;                               // Store the number of devices
-  StartTimer();                                   // Enable timer interrupts
-  setMode(0, MODE_SETTINGS);                      // Retrieve settings on first call
-  setMode(1, MODE_SETTINGS);                      // Retrieve settings on first call
-}  // of class constructor
-CubigelClass::CubigelClass(SoftwareSerial *serial1, HardwareSerial *serial2) {
-  /*!
-    @brief     Constructor (overloaded) for a SW and a HW serial port
-    @details   Point to appropriate hardware and serial ports
-    @param[in] serial1 Pointer to software serial port
-    @param[in] serial2 Pointer to hardware serial port
-  */
-  ClassPtr            = this;                     // pointer to current instance
-  devices[0].serialSW = serial1;                  // point to the appropriate port
-  devices[0].serialSW->begin(CUBIGEL_BAUD_RATE);  // Set baud rate to Cubigel speed
-  devices[1].serialHW = serial2;                  // point to the appropriate port
-  devices[1].serialHW->begin(CUBIGEL_BAUD_RATE);  // Set baud rate to Cubigel speed
-  _deviceCount = 2;                               // Store the number of devices
-  StartTimer();                                   // Enable timer interrupts
-  setMode(0, MODE_SETTINGS);                      // Retrieve settings on first call
-  setMode(1, MODE_SETTINGS);                      // Retrieve settings on first call
-}  // of class constructor
-CubigelClass::CubigelClass(HardwareSerial *serial1, HardwareSerial *serial2) {
-  /*!
-    @brief     Constructor (overloaded) for a HW and a HW serial port
-    @details   Point to appropriate hardware and serial ports
-    @param[in] serial1 Pointer to hardware serial port
-    @param[in] serial2 Pointer to hardware serial port
-  */
-  ClassPtr            = this;                     // pointer to current instance
-  devices[0].serialHW = serial1;                  // point to the appropriate port
-  devices[0].serialHW->begin(CUBIGEL_BAUD_RATE);  // Set baud rate to Cubigel speed
-  devices[1].serialHW = serial2;                  // point to the appropriate port
-  devices[1].serialHW->begin(CUBIGEL_BAUD_RATE);  // Set baud rate to Cubigel speed
-  _deviceCount = 2;                               // Store the number of devices
-  StartTimer();                                   // Enable timer interrupts
-  setMode(0, MODE_SETTINGS);                      // Retrieve settings on first call
-  setMode(1, MODE_SETTINGS);                      // Retrieve settings on first call
-}  // of class constructor
+  if (!_timed) return;                                       // Never on the list
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {                        // The interrupt walks the list
+    CUBIGEL_PROFILE_OFF();                                   // Timed with CUBIGEL_PROFILE
+    CubigelClass *volatile *link = &_firstTimed;             // Find the pointer to this one
+    while (*link != nullptr && *link != this) link = &(*link)->_nextTimed;
+    if (*link == this) *link = _nextTimed;                   // and skip over it
+  }                                                          // of ATOMIC_BLOCK
+}  // of class destructor
+uint8_t CubigelClass::addDevice(HardwareSerial *serial, const uint8_t readMode) {
+  /*!
+   * @brief     Add a device connected to a hardware serial port
+   * @param[in] serial   Pointer to hardware serial port
+   * @param[in] readMode CUBIGEL_EVENT if the program calls onReceive() from the port's
+   *                     serialEvent function, otherwise the port is read the same way as the
+   *                     others. Defaults to CUBIGEL_TIMER
+   * @return    Index of the device, or CUBIGEL_NO_DEVICE if there is no room left
+   */
+  if (_deviceCount == _capacity) return CUBIGEL_NO_DEVICE;  // No room for another device
+  serial->begin(CUBIGEL_BAUD_RATE);                         // Set baud rate to Cubigel speed
+  return addDevice(static_cast<Stream *>(serial),           // and add it, tagged if event
+                   CUBIGEL_PORT_BUFFERED | (readMode == CUBIGEL_EVENT ? CUBIGEL_PORT_EVENT : 0));
+}  // of method addDevice()
+#if defined(CUBIGEL_SOFTWARE_SERIAL)
+uint8_t CubigelClass::addDevice(SoftwareSerial *serial) {
+  /*!
+   * @brief     Add a device connected to a software serial port
+   * @param[in] serial Pointer to software serial port
+   * @return    Index of the device, or CUBIGEL_NO_DEVICE if there is no room left
+   */
+  if (_deviceCount == _capacity) return CUBIGEL_NO_DEVICE;  // No room for another device
+  serial->begin(CUBIGEL_BAUD_RATE);                         // Set baud rate to Cubigel speed
+  return addDevice(serial, CUBIGEL_PORT_SOFTWARE);          // and add it, tagged as software
+}  // of method addDevice()
+#endif
+uint8_t CubigelClass::addDevice(Stream *serial) {
+  /*!
+   * @brief     Add a device using any Stream, which must already have been started at 1200 baud
+   * @param[in] serial Pointer to serial port
+   * @return    Index of the device, or CUBIGEL_NO_DEVICE if there is no room left
+   */
+  return addDevice(serial, 0);  // Add it without any port flags
+}  // of method addDevice()
+uint8_t CubigelClass::addDevice(Stream *serial, const uint8_t flags) {
+  /*!
+   * @brief     Add a device, storing the port pointer tagged with the type of port
+   * @details   The device is only counted once its storage is set up, so that the timer interrupt
+   *            never sees a partially initialized device. A settings sentence is requested so that
+   *            the settings are available straight away. The timer interrupt is started with the
+   *            first device that it needs to read
+   * @param[in] serial Pointer to serial port
+   * @param[in] flags  CUBIGEL_PORT_xxx bits for the type of port
+   * @return    Index of the device, or CUBIGEL_NO_DEVICE if there is no room left
+   */
+  if (_deviceCount == _capacity) return CUBIGEL_NO_DEVICE;     // No room for another device
+  uint8_t idx        = _deviceCount;                           // Index of the new device
+  devices[idx].port  = serial;                                 // point to the appropriate port
+  devices[idx].flags = flags;                                  // and store what type it is
+  devices[idx].txIndex = CUBIGEL_COMMAND_BYTES;                // Nothing being transmitted
+  devices[idx].txNext  = CUBIGEL_NO_COMMAND;                   // and nothing waiting
+  devices[idx].nextRefresh = millis() + _refreshMillis;        // Next periodic settings request
+  settings[idx].resetTime  = millis();                         // Statistics start now
+  _deviceCount      = idx + 1;                                 // Now the interrupt can use it
+  if (!_polled && !_timed && !(flags & CUBIGEL_PORT_EVENT)) {  // The timer reads the port and
+    bool first = _firstTimed == nullptr;                       // this instance isn't on the list
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {                        // yet, so add it at the front
+      CUBIGEL_PROFILE_OFF();                                   // Timed with CUBIGEL_PROFILE
+      _nextTimed  = _firstTimed;                               //
+      _firstTimed = this;                                      //
+    }                                                          // of ATOMIC_BLOCK
+    _timed = true;                                             //
+    if (first) StartTimer();                                   // Enable the interrupt once
+  }                                                            // of if-then add to the timer list
+  setMode(idx, MODE_SETTINGS);                                 // Retrieve settings on first call
+  return idx;
+}  // of method addDevice()
 
 void CubigelClass::StartTimer() const {
   /*!
     @brief   starts TIMER0_COMPA timer
-    @details called as part of class instantiation to enable internal timing. The code uses the
-             Timer0 interrupt (also used by the millis() function) which is an 8 bit register with a
-             clock divisor of 64 which triggers it to overflow at a rate of 976.5625Hz, or roughly
-             every millisecond. We set TIMER0_COMPA_vect to 0x01 which triggers when the value is
-             equal to 64. This gives us an identical trigger speed to the millis() function but at a
-             different trigger point.
+    @details called when the first device read by the timer is added to any instance to enable
+             internal timing. The code uses the Timer0 interrupt (also used by the millis()
+             function) which is an 8 bit register with a clock divisor of 64 which triggers it to
+             overflow at a rate of 976.5625Hz, or roughly every millisecond. We set
+             TIMER0_COMPA_vect to 0x01 which triggers when the value is equal to 64. This gives us
+             an identical trigger speed to the millis() function but at a different trigger point.
+             On a host build there is no timer, the host program calls TimerISR() directly instead.
     @return void
   */
-  cli();                  // Disable interrupts
-  OCR0A = 0x40;           // Comparison register A to 64
-  TIMSK0 |= _BV(OCIE0A);  // TIMER0_COMPA trigger on 0x01
-  sei();                  // Enable interrupts
+#if defined(__AVR__) && !defined(CUBIGEL_NO_TIMER)  // Only AVR processors have Timer0
+  cli();                                            // Disable interrupts
+  OCR0A = 0x40;                                     // Comparison register A to 64
+  TIMSK0 |= _BV(OCIE0A);                            // TIMER0_COMPA trigger on 0x01
+  sei();                                            // Enable interrupts
+#endif
 }  // of method StartTimer()
+#if defined(__AVR__) && !defined(CUBIGEL_NO_TIMER)
 ISR(TIMER0_COMPA_vect) {
   /*!
     @brief   Define the ISR (Interrupt Service Routine) for the timer event
@@ -127,30 +202,757 @@ ISR(TIMER0_COMPA_vect) {
   */
   CubigelClass::TimerISR();  // Call the ISR every millisecond
 }  // of ISR definition
-static void CubigelClass::TimerISR() {
+#endif
+void CubigelClass::TimerISR() {
   /*!
   @brief   Timer redirect
+  @details Calls the handler of every instance with devices read by the timer, so the time taken
+           depends on the total number of devices rather than on how they are split up. When
+           compiled with CUBIGEL_PROFILE the length of the whole tick is measured and it is counted
+           as busy when any of the instances read or sent something
   @return void
 */
-  ClassPtr->TimerHandler();
+#if defined(CUBIGEL_PROFILE)
+  uint32_t start = CUBIGEL_PROFILE_CLOCK();                  // Start of the tick
+  bool     busy  = false;                                    // Set when anything was done
+  profileInTick  = true;                                     // The tick's blocks are part of it
+  for (CubigelClass *instance = _firstTimed; instance != nullptr; instance = instance->_nextTimed) {
+    if (instance->TimerHandler()) busy = true;               // Read this instance's devices
+  }                                                          // of for-next each instance
+  uint32_t elapsed = CUBIGEL_PROFILE_CLOCK() - start;        // Length of this tick
+  profileTicks     = profileTicks + 1;                       // Count the tick
+  if (busy) profileBusy = profileBusy + 1;                   // Read or sent something
+  if (elapsed < profileMin) profileMin = elapsed;            // Keep the shortest
+  if (elapsed > profileMax) profileMax = elapsed;            // and longest ticks
+  while (elapsed > UINT32_MAX - profileTotal) {              // Keep the sum in 32 bits by
+    profileTotal  = profileTotal >> 1;                       // halving it and its count, the
+    profileSummed = profileSummed >> 1;                      // mean stays the same
+  }                                                          // of while-loop sum would overflow
+  profileTotal  = profileTotal + elapsed;                    // Sum for the mean
+  profileSummed = profileSummed + 1;                         //
+  profileInTick = false;                                     // Tick done
+#else
+  for (CubigelClass *instance = _firstTimed; instance != nullptr; instance = instance->_nextTimed) {
+    instance->TimerHandler();                                // Read this instance's devices
+  }                                                          // of for-next each instance
+#endif
 }  // Redirect to real handler function
-void CubigelClass::TimerHandler() {
+bool CubigelClass::TimerHandler() {
   /*!
   @brief   linked to the millis() timer 0 interrupt
   @details This is called every millisecond and we check to see if anything has arrived in the
            receive buffers. Each devices' buffer is checked and any that have data in them are
-           processed using the "processDevice" function, which does the heavy lifting
-  */
-  for (uint8_t idx = 0; idx < _deviceCount; idx++) {  // For each defined device
-    if (devices[idx].serialSW) {                      // if we are using software serial,
-      if (devices[idx].serialSW->available())
-        processDevice(idx);  // check to see if there is any data
-    } else {                 // otherwise we are using HW serial
-      if (devices[idx].serialHW->available())
-        processDevice(idx);  // check to see if there is any data
-    }                        // of if-then-else software or hardware serial
-  }                          // of for-next each defined device loop
+           processed using the "processDevice" function, which does the heavy lifting. Up to
+           "_burstBytes" bytes are read from each device so that a backlog built up while
+           interrupts were disabled is cleared quickly, but no more than "_tickBudget" bytes are
+           read in total so that the time spent in the interrupt stays bounded. Bytes which the
+           parser replays after a failed checksum count against both limits, and a replay which
+           doesn't fit is finished in the next tick before any more bytes are read, so the limits
+           are on parser steps rather than on bytes received. Each step costs about the same,
+           except that a failed checksum also searches the up to CUBIGEL_SENTENCE_MAX bytes of the
+           failed sentence for a new start byte. The device read first is rotated each tick so
+           that a small budget doesn't always starve the same device. Event driven ports are
+           skipped, since they are read by onReceive()
+  @return  true when any bytes were read or sent, so TimerISR() can count busy ticks
+  */
+  bool    sent    = false;                                  // Set when a command byte was sent
+  uint8_t budget  = _tickBudget;                            // Parser steps left this tick
+  uint8_t idx     = _nextDevice;                            // Device to start with
+  bool    limited = false;                                  // Set when bytes had to be left
+  for (uint8_t count = 0; count < _deviceCount; ++count) {  // For each defined device
+    int waiting = 0;                                        // Bytes waiting, 0 if event driven
+    if (!(devices[idx].flags & CUBIGEL_PORT_EVENT)) waiting = devices[idx].port->available();
+    CubigelParser &parser = parsers[idx];                 // Parser, which may have a replay
+    uint8_t        burst  = budget < _burstBytes ? budget : _burstBytes;  // Steps allowed
+    while (burst && (waiting > 0 || parser.pending())) {  // Bytes or a replay to process
+      if (!parser.pending()) --waiting;                   // A new byte is read from the port
+      uint8_t steps = processDevice(idx, burst);          // Process, replaying no more than allowed
+      burst -= steps;                                     // Use up part of the device's
+      budget -= steps;                                    // and the tick's limits
+    }                                                     // of while-loop bytes to process
+    if (waiting > 0 || parser.pending()) limited = true;  // Remember the limit was hit
+    if (devices[idx].txIndex < CUBIGEL_COMMAND_BYTES &&
+        (devices[idx].flags & (CUBIGEL_PORT_EVENT | CUBIGEL_PORT_BUFFERED)) ==
+            CUBIGEL_PORT_BUFFERED) {                     // Command bytes waiting, port won't block
+      transmit(idx);                                     // Send what fits in the transmit buffer
+      sent = true;                                       // The tick did something
+    }                                                    // of if-then command bytes to send
+    if (++idx == _deviceCount) idx = 0;                  // Next device, wrapping around
+  }                                                      // of for-next each defined device loop
+  if (++_nextDevice >= _deviceCount) _nextDevice = 0;    // Rotate the first device
+  if (limited && _budgetHits != UINT16_MAX) _budgetHits = _budgetHits + 1;  // Count, saturating
+  return sent || budget != _tickBudget;                  // Whether the tick did something
 }  // of method TimerHandler()
+uint16_t CubigelClass::poll() {
+  /*!
+  @brief     read and process every byte waiting in the device receive buffers
+  @details   Only used in polled mode, where it is called by the program from "loop()" or its own
+             scheduler instead of the ports being read from the timer interrupt. All waiting bytes
+             are processed in one batch, so the burst limits set with setBurst() don't apply. At
+             1200 baud just over one byte arrives per millisecond and the Arduino receive buffer
+             holds 64, so it should be called at least every 50ms or so. When the timer interrupt
+             reads the ports it only sends the waiting command bytes of ports without a transmit
+             buffer, one byte per device, since writing those would hold up the interrupt
+  @return    Number of bytes processed, always 0 when the timer interrupt reads the ports
+  */
+  if (!_polled) {                                           // The interrupt reads the ports but
+    for (uint8_t idx = 0; idx < _deviceCount; ++idx) {      // leaves the command bytes for ports
+      if (!(devices[idx].flags & CUBIGEL_PORT_BUFFERED)) transmit(idx);  // which would block
+    }                                                       // of for-next each defined device
+    return 0;
+  }                                                         // of if-then read by the interrupt
+  uint16_t bytes = 0;                                       // Bytes processed
+  for (uint8_t idx = 0; idx < _deviceCount; ++idx) {        // For each defined device
+    if (devices[idx].flags & CUBIGEL_PORT_EVENT) continue;  // Read by onReceive() instead
+    int waiting = devices[idx].port->available();           // Bytes in the receive buffer
+    bytes += waiting;                                       // Count them and
+    while (waiting-- > 0) processDevice(idx);               // process them
+    transmit(idx);                                          // then send any waiting command bytes
+  }                                                         // of for-next each defined device
+  return bytes;
+}  // of method poll()
+uint16_t CubigelClass::onReceive(const uint8_t idx) {
+  /*!
+  @brief     read and process every byte waiting for a device that was added with CUBIGEL_EVENT
+  @details   Called from the Arduino "serialEventN()" function of the device's hardware port, which
+             the Arduino core runs after "loop()" whenever the port has received data, e.g.
+             "void serialEvent1() { Cubigel.onReceive(1); }". The bytes are processed here rather
+             than in the timer interrupt, so nothing is done while no data arrives
+  @param[in] idx Index to device array
+  @return    Number of bytes processed, 0 if the device isn't event driven or the index is invalid
+  */
+  if (idx >= _deviceCount || !(devices[idx].flags & CUBIGEL_PORT_EVENT)) return 0;  // Not ours
+  int waiting = devices[idx].port->available();  // Bytes in the receive buffer
+  for (int count = 0; count < waiting; ++count) processDevice(idx);  // Process them
+  transmit(idx);                                 // then send any waiting command bytes
+  return waiting;
+}  // of method onReceive()
+void CubigelClass::setBurst(const uint8_t deviceBytes, const uint8_t tickBytes) {
+  /*!
+  @brief     set how many bytes are read in each timer tick
+  @details   At 1200 baud a device sends just over one byte per millisecond, so reading more than
+             one byte per tick lets the library catch up after interrupts have been disabled for a
+             while rather than letting the serial receive buffer overflow
+  @param[in] deviceBytes Maximum bytes parsed for each device per tick, including bytes replayed
+                         after a failed checksum, at least 1
+  @param[in] tickBytes   Maximum bytes parsed for all devices together per tick, at least 1
+  @return    void
+  */
+  interruptsOff();                               // Disable interrupts
+  _burstBytes = deviceBytes ? deviceBytes : 1;   // Never allow 0, the
+  _tickBudget = tickBytes ? tickBytes : 1;       // ports would never be read
+  interruptsOn();                                // Enable interrupts
+}  // of method setBurst()
+void CubigelClass::setTransitionCallback(CubigelEventCallback callback) {
+  /*!
+  @brief     set the function called by dispatchEvents() when a compressor turns on or off
+  @param[in] callback Function to call, or nullptr to just discard these events
+  @return    void
+  */
+  _transitionCallback = callback;
+}  // of method setTransitionCallback()
+void CubigelClass::setAlarmCallback(CubigelEventCallback callback) {
+  /*!
+  @brief     set the function called by dispatchEvents() when a compressor's alarm code changes
+  @param[in] callback Function to call, or nullptr to just discard these events
+  @return    void
+  */
+  _alarmCallback = callback;
+}  // of method setAlarmCallback()
+void CubigelClass::queueEvent(const uint8_t idx, const uint8_t kind, const uint8_t alarm,
+                              const uint32_t time) {
+  /*!
+  @brief     add an event to the event queue, or count it if the queue is full
+  @details   Only the calling program moves the tail and only this function the head. Event driven
+             devices call this from the foreground while timer driven ones call it from the
+             interrupt, so the few instructions needed are done with interrupts disabled to stop the
+             two from writing the same entry
+  @param[in] idx   Index to device array
+  @param[in] kind  CubigelEventKind value
+  @param[in] alarm Alarm code for CUBIGEL_ALARM events
+  @param[in] time  millis() value of the sentence showing the change
+  @return    void
+  */
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {                    // Interrupts off, restored afterwards
+    CUBIGEL_PROFILE_OFF();                               // Timed with CUBIGEL_PROFILE
+    uint8_t head = _eventHead;                           // Entry to write
+    uint8_t next = head + 1 == _eventSize ? 0 : head + 1;  // Following entry
+    if (next == _eventTail) {                            // Queue is full, so count the
+      if (_eventsDropped != UINT16_MAX) _eventsDropped = _eventsDropped + 1;  // lost event
+    } else {                                             // otherwise store it
+      volatile CubigelEventType &event = events[head];   //
+      event.time   = time;                               //
+      event.device = idx;                                //
+      event.kind   = kind;                               //
+      event.alarm  = alarm;                              //
+      _eventHead   = next;                               // and make it visible to the reader
+    }                                                    // of if-then-else queue is full
+  }                                                      // of atomic block
+}  // of method queueEvent()
+bool CubigelClass::readEvent(CubigelEventType &event) {
+  /*!
+  @brief      take the oldest event off the queue without calling any callback
+  @param[out] event Copy of the event
+  @return     false if the queue is empty
+  */
+  uint8_t tail = _eventTail;                    // Oldest entry
+  if (tail == _eventHead) return false;         // Nothing waiting
+  volatile CubigelEventType &entry = events[tail];
+  event.time   = entry.time;                             // Copy the event
+  event.device = entry.device;                           //
+  event.kind   = entry.kind;                             //
+  event.alarm  = entry.alarm;                            //
+  _eventTail   = tail + 1 == _eventSize ? 0 : tail + 1;  // then free the entry
+  return true;
+}  // of method readEvent()
+uint8_t CubigelClass::dispatchEvents() {
+  /*!
+  @brief     take every waiting event off the queue and call the registered callback for it
+  @details   Called from "loop()", so the callbacks run outside of the interrupt and may take as
+             long as they need to and use the serial ports. Events without a callback are discarded
+  @return    Number of events taken off the queue
+  */
+  uint8_t          count = 0;                             // Events taken off the queue
+  CubigelEventType event;                                 // Copy of the event
+  while (readEvent(event)) {                              // For each waiting event
+    CubigelEventCallback callback = _transitionCallback;  // Find the function to call
+    if (event.kind == CUBIGEL_ALARM) callback = _alarmCallback;
+    if (event.kind == CUBIGEL_SETTINGS_CHANGED) callback = _settingsCallback;
+    if (callback) callback(event);              // and call it, if there is one
+    ++count;                                    //
+  }                                             // of while-loop events waiting
+  return count;
+}  // of method dispatchEvents()
+uint16_t CubigelClass::readEventsDropped(const bool reset) {
+  /*!
+  @brief     return the number of events discarded because the event queue was full, in which case
+             dispatchEvents() isn't called often enough or the queue needs to be larger
+  @param[in] reset optional parameter that resets the counter when "true". Default false.
+  @return    Number of events, stops at 65535
+  */
+  interruptsOff();                         // Disable interrupts
+  uint16_t dropped = _eventsDropped;       // Copy the value
+  if (reset) _eventsDropped = 0;           // Reset if so desired
+  interruptsOn();                          // Enable interrupts
+  return dropped;
+}  // of method readEventsDropped()
+bool CubigelClass::setSupplyVoltage(const uint8_t idx, const uint16_t millivolts) {
+  /*!
+  @brief     set the supply voltage used by readEnergy() to turn the charge into energy
+  @details   The FDC1 doesn't send the battery voltage, so the nominal voltage of the band in use,
+             CUBIGEL_12V, CUBIGEL_24V or CUBIGEL_42V, or a measured value is used
+  @param[in] idx        Index to device array
+  @param[in] millivolts Supply voltage in mV, 0 for the default of CUBIGEL_12V
+  @return    false if the device index is invalid
+  */
+  if (idx >= _deviceCount) return false;  // just return nothing if invalid
+  settings[idx].supplyVoltage = millivolts;
+  return true;
+}  // of method setSupplyVoltage()
+static const uint16_t kRawMsPerMahK = CUBIGEL_RAW_MS_PER_MAH / 1000;  ///< 1 mAh in 1000 raw x ms
+static_assert(CUBIGEL_RAW_MS_PER_MAH % 1000 == 0, "readEnergy() splits 1 mAh into 1000 parts");
+CubigelEnergyType CubigelClass::readEnergy(const uint8_t idx) {
+  /*!
+  @brief     return the charge, energy, running and stopped times and cycle counts of a device
+  @details   The totals are kept by the interrupt from when the device was added and are copied
+             again if the interrupt changed them during the copy. The energy, duty cycle and mean
+             cycle length are worked out here so that the interrupt doesn't need to divide, and
+             only with 32 bit arithmetic. The energy is exactly what a 64 bit calculation gives,
+             while the duty cycle can be a hundredth of a percent out once the totals pass 5 days
+  @param[in] idx Index to device array
+  @return    Totals for the device, all zero if the index is invalid
+  */
+  CubigelEnergyType energy = {};                    // Everything zero by default
+  if (idx >= _deviceCount) return energy;           // just return nothing if invalid
+  volatile CubigelDataType &device = devices[idx];  // Reference to device storage
+  uint32_t chargePart;                              // Raw current x ms below one mAh
+  uint8_t  sequence;                                // Sequence number before the copy
+  do {                                              // Repeat until the interrupt didn't change
+    sequence           = device.sequence;           // the values during the copy
+    energy.mAh         = device.chargemAh;          //
+    chargePart         = device.chargePart;         //
+    energy.runSeconds  = device.runSeconds;         //
+    energy.stopSeconds = device.stopSeconds;        //
+    energy.cycles      = device.cycles;             //
+  } while ((sequence & 1) || sequence != device.sequence);
+  energy.supplyVoltage = settings[idx].supplyVoltage ? settings[idx].supplyVoltage : CUBIGEL_12V;
+  uint32_t mV   = energy.supplyVoltage;  // The products are split up so that none of them needs
+  uint32_t high = chargePart / 1000 * mV;  // more than 32 bits, which keeps the 64 bit division
+  uint32_t low  = chargePart % 1000 * mV;  // routines out of an Atmel program
+  uint32_t uWh  = (high % kRawMsPerMahK * 1000 + low) / CUBIGEL_RAW_MS_PER_MAH;  // Part mAh x mV
+  uWh += high / kRawMsPerMahK;                                                   // in uWh
+  energy.mWh = energy.mAh * (mV / 1000) + energy.mAh / 1000 * (mV % 1000);  // mAh x mV to mWh
+  energy.mWh += (energy.mAh % 1000 * (mV % 1000) + uWh) / 1000;            // and the remainders
+  uint32_t total = energy.runSeconds + energy.stopSeconds;  // Seconds with sentences
+  if (total) {                                              // Pre-scale so that the running time
+    uint32_t run   = energy.runSeconds;                     // x 10000 fits into 32 bits, which
+    uint32_t whole = total;                                 // only changes anything after 5 days
+    while (whole > UINT32_MAX / 10000) {                    //
+      run >>= 1;                                            //
+      whole >>= 1;                                          //
+    }                                                       // of while-loop too large
+    energy.dutyCycle = run * 10000 / whole;                 // Hundredths of a percent
+  }                                                         // of if-then any seconds
+  if (energy.cycles) energy.cycleSeconds = total / energy.cycles;
+  return energy;
+}  // of method readEnergy()
+static uint8_t *putWord(uint8_t *buffer, const uint16_t value) {
+  /*!
+    @brief     Store a 16 bit value little-endian, whatever the byte order of the processor
+    @param[in] buffer Where to store the value
+    @param[in] value  Value to store
+    @return    Position after the value
+  */
+  *buffer++ = value & 0xFF;
+  *buffer++ = value >> 8;
+  return buffer;
+}  // of function putWord()
+static uint8_t *putLong(uint8_t *buffer, const uint32_t value) {
+  /*!
+    @brief     Store a 32 bit value little-endian, whatever the byte order of the processor
+    @param[in] buffer Where to store the value
+    @param[in] value  Value to store
+    @return    Position after the value
+  */
+  buffer = putWord(buffer, value & 0xFFFF);
+  return putWord(buffer, value >> 16);
+}  // of function putLong()
+uint8_t CubigelClass::packTelemetry(const uint8_t idx, uint8_t *buffer, const uint8_t size,
+                                    const bool reset) {
+  /*!
+  @brief     write a device's statistics as a binary record into the caller's buffer
+  @details   The record is CUBIGEL_TELEMETRY_BYTES long, all values are little-endian:
+
+             Offset | Size | Contents
+             ------ | ---- | ------------------------------------------------------------------
+             0      | 1    | CUBIGEL_TELEMETRY_SYNC
+             1      | 1    | CUBIGEL_TELEMETRY_VERSION
+             2      | 1    | Record length, CUBIGEL_TELEMETRY_BYTES
+             3      | 1    | Device index
+             4      | 4    | millis() when the record was made
+             8      | 4    | Milliseconds since the statistics were last reset
+             12     | 2    | Readings
+             14     | 2    | Readings while running
+             16     | 6    | Average, lowest and highest RPM while running
+             22     | 6    | Average, lowest and highest mA while running
+             28     | 2    | Comms errors
+             30     | 1    | OR'd alarm codes
+             31     | 2    | Duty cycle since the device was added, 1/100ths of a percent
+             33     | 2    | Compressor starts since the device was added
+             35     | 4    | Mean cycle length in seconds
+             39     | 2    | CRC-16/CCITT of bytes 0 to 38
+
+             The statistics come from readStatistics() and the cycle values from readEnergy()
+  @param[in] idx    Index to device array
+  @param[in] buffer Storage for the record
+  @param[in] size   Size of the buffer, at least CUBIGEL_TELEMETRY_BYTES
+  @param[in] reset  optional parameter that doesn't reset readings when "false". Default true.
+  @return    Number of bytes written, 0 if the index is invalid or the buffer too small
+  */
+  if (idx >= _deviceCount || size < CUBIGEL_TELEMETRY_BYTES) return 0;  // Nothing if invalid
+  uint32_t           now      = millis();                   // Time of the record and length of
+  uint32_t           interval = now - settings[idx].resetTime;  // the statistics, before reset
+  CubigelSummaryType summary  = readStatistics(idx, reset);  // Statistics while running
+  CubigelEnergyType  energy   = readEnergy(idx);            // Cycle totals
+  uint8_t *          next     = buffer;                     // Next byte to write
+  *next++                     = CUBIGEL_TELEMETRY_SYNC;     // Header
+  *next++                     = CUBIGEL_TELEMETRY_VERSION;  //
+  *next++                     = CUBIGEL_TELEMETRY_BYTES;    //
+  *next++                     = idx;                        //
+  next = putLong(next, now);                                // Period covered
+  next = putLong(next, interval);                           //
+  next = putWord(next, summary.readings);                   // Statistics
+  next = putWord(next, summary.running);                    //
+  next = putWord(next, summary.RPM);                        //
+  next = putWord(next, summary.minRPM);                     //
+  next = putWord(next, summary.maxRPM);                     //
+  next = putWord(next, summary.mA);                         //
+  next = putWord(next, summary.minmA);                      //
+  next = putWord(next, summary.maxmA);                      //
+  next = putWord(next, summary.commsErrors);                //
+  *next++ = summary.errorStatus;                            //
+  next    = putWord(next, energy.dutyCycle);                // Cycle totals
+  next    = putWord(next, energy.cycles);                   //
+  next    = putLong(next, energy.cycleSeconds);             //
+  uint16_t crc = 0xFFFF;                                    // Checksum everything so far
+  for (uint8_t *byte = buffer; byte < next; ++byte) crc = cubigelCrc16(crc, *byte);
+  next = putWord(next, crc);                                //
+  return next - buffer;
+}  // of method packTelemetry()
+void CubigelClass::setSettingsCallback(CubigelEventCallback callback) {
+  /*!
+  @brief     set the function called by dispatchEvents() when a device's settings have changed
+  @param[in] callback Function to call, or nullptr to just discard these events
+  @return    void
+  */
+  _settingsCallback = callback;
+}  // of method setSettingsCallback()
+uint16_t CubigelClass::readBudgetHits(const bool reset) {
+  /*!
+  @brief     return the number of timer ticks which had to leave bytes unread because the per device
+             or per tick limit was reached. A steadily rising value means that the limits set with
+             setBurst() are too low for the number of devices or the time interrupts are disabled
+  @param[in] reset optional parameter that doesn't reset the counter when "false". Default true.
+  @return    Number of ticks, stops at 65535
+  */
+  interruptsOff();                    // Disable interrupts
+  uint16_t hits = _budgetHits;        // Copy the value
+  if (reset) _budgetHits = 0;         // Reset if so desired
+  interruptsOn();                     // Enable interrupts
+  return hits;
+}  // of method readBudgetHits()
+void CubigelClass::setCapture(CubigelCaptureType *buffer, uint8_t size) {
+  /*!
+  @brief     set the ring buffer used to capture every byte read from the ports
+  @details   The buffer belongs to the calling program and must stay valid while it is in use; one
+             entry is always kept free, so the buffer holds up to "size - 1" bytes. Any entries in
+             a previous buffer are discarded. Passing a nullptr or a size below 2 turns the capture
+             off
+  @param[in] buffer Array of "size" capture entries
+  @param[in] size   Number of entries in the array
+  @return    void
+  */
+  if (buffer == nullptr || size < 2) size = 0;       // Turn the capture off
+  interruptsOff();                                   // Disable interrupts while changing
+  _capture     = size ? buffer : nullptr;            // Set the new buffer and empty it
+  _captureSize = size;                               //
+  _captureHead = 0;                                  //
+  _captureTail = 0;                                  //
+  interruptsOn();                                    // Enable interrupts
+}  // of method setCapture()
+void CubigelClass::captureByte(const uint8_t idx, const uint8_t value, const uint8_t status) {
+  /*!
+  @brief     add a byte read from a port to the capture, or count it if the buffer is full
+  @details   As with queueEvent(), timer driven devices get here from the interrupt and event driven
+             ones from the foreground, so the head is moved with interrupts disabled
+  @param[in] idx    Index to device array
+  @param[in] value  Byte read from the port
+  @param[in] status CubigelParseStatus the parser returned for it
+  @return    void
+  */
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {                    // Interrupts off, restored afterwards
+    CUBIGEL_PROFILE_OFF();                               // Timed with CUBIGEL_PROFILE
+    uint8_t head = _captureHead;                         // Entry to write
+    uint8_t next = head + 1 == _captureSize ? 0 : head + 1;  // Following entry
+    if (next == _captureTail) {                          // Buffer is full, so count the
+      if (_captureDropped != UINT16_MAX) _captureDropped = _captureDropped + 1;  // lost byte
+    } else {                                             // otherwise store it
+      volatile CubigelCaptureType &entry = _capture[head];  //
+      entry.time   = millis();                           //
+      entry.device = idx;                                //
+      entry.value  = value;                              //
+      entry.status = status;                             //
+      _captureHead = next;                               // and make it visible to the reader
+    }                                                    // of if-then-else buffer is full
+  }                                                      // of atomic block
+}  // of method captureByte()
+uint8_t CubigelClass::readCapture(CubigelCaptureType *entries, const uint8_t maxEntries) {
+  /*!
+  @brief      copy the oldest waiting capture entries into the caller's array
+  @details    The entries are copied oldest first and then released in one step by moving the tail
+              index, so bytes can keep being captured while this is running
+  @param[out] entries    Array for at least "maxEntries" entries
+  @param[in]  maxEntries Maximum number of entries to copy
+  @return     Number of entries copied, 0 if none are waiting
+  */
+  uint8_t size  = _captureSize;                            // Ring buffer size
+  uint8_t head  = _captureHead;                            // Entries up to here are complete
+  uint8_t tail  = _captureTail;                            // Oldest entry waiting
+  uint8_t count = 0;                                       // Entries copied
+  while (tail != head && count < maxEntries) {             // Copy each waiting entry
+    volatile CubigelCaptureType &entry = _capture[tail];
+    entries[count].time   = entry.time;                    //
+    entries[count].device = entry.device;                  //
+    entries[count].value  = entry.value;                   //
+    entries[count].status = entry.status;                  //
+    ++count;                                               //
+    if (++tail == size) tail = 0;                          // Wrap around at the end
+  }                                                        // of while-loop entries to copy
+  _captureTail = tail;                                     // Release the copied entries
+  return count;
+}  // of method readCapture()
+uint16_t CubigelClass::readCaptureDropped(const bool reset) {
+  /*!
+  @brief     return the number of bytes which weren't captured because the capture buffer was full,
+             in which case readCapture() isn't called often enough or the buffer needs to be larger
+  @param[in] reset optional parameter that resets the counter when "true". Default false.
+  @return    Number of bytes, stops at 65535
+  */
+  interruptsOff();                         // Disable interrupts
+  uint16_t dropped = _captureDropped;      // Copy the value
+  if (reset) _captureDropped = 0;          // Reset if so desired
+  interruptsOn();                          // Enable interrupts
+  return dropped;
+}  // of method readCaptureDropped()
+CubigelLinkType CubigelClass::readLinkStats(const uint8_t idx, const bool reset) {
+  /*!
+  @brief     return a device's link counters and sentence gap histogram
+  @details   The counters are copied again if the interrupt changed them during the copy. Since
+             the interrupt also writes to them, resetting them, including the parser's own byte
+             count, is done with interrupts disabled
+  @param[in] idx   Index to device array
+  @param[in] reset optional parameter that resets the counters when "true". Default false.
+  @return    Copy of the counters, all zero if the index is invalid
+  */
+  CubigelLinkType stats = {};                            // Everything zero by default
+  if (idx >= _deviceCount) return stats;                 // just return nothing if invalid
+  volatile CubigelDataType &device = devices[idx];       // Reference to device storage
+  volatile CubigelLinkType &link   = device.link;        // Link counters
+  uint8_t                   sequence;                    // Sequence number before the copy
+  if (reset) interruptsOff();                            // Nothing may change until cleared
+  do {                                                   // Repeat until the interrupt didn't
+    sequence          = device.sequence;                 // change the values during the copy
+    stats.bytes       = link.bytes;                      //
+    stats.frames      = link.frames;                     //
+    stats.badStart    = link.badStart;                   //
+    stats.badType     = link.badType;                    //
+    stats.badChecksum = link.badChecksum;                //
+    for (uint8_t i = 0; i < CUBIGEL_GAP_BUCKETS; ++i) stats.gaps[i] = link.gaps[i];
+  } while ((sequence & 1) || sequence != device.sequence);
+  if (reset) {                                           // Clear the counters
+    link.bytes       = 0;                                //
+    link.frames      = 0;                                //
+    link.badStart    = 0;                                //
+    link.badType     = 0;                                //
+    link.badChecksum = 0;                                //
+    for (uint8_t i = 0; i < CUBIGEL_GAP_BUCKETS; ++i) link.gaps[i] = 0;
+    parsers[idx].resetBytes();                           //
+    interruptsOn();                                      // Enable interrupts
+  }                                                      // of if-then reset the counters
+  return stats;
+}  // of method readLinkStats()
+uint8_t CubigelClass::readHealth(const uint8_t idx, const bool reset) {
+  /*!
+  @brief     return a device's health flags, a single byte for a gateway to poll
+  @details   The conditions found by the health check in the latest sentences are combined with
+             those seen since the last reset, so that a gateway polling now and then still sees a
+             short cycling problem which has since stopped. Clearing them is done with interrupts
+             disabled since the interrupt sets them
+  @param[in] idx   Index to device array
+  @param[in] reset optional parameter that doesn't clear the conditions seen when "false". Default
+                   true.
+  @return    CUBIGEL_HEALTH_xxx flags OR'd together, 0 if the index is invalid or all is well
+  */
+  if (idx >= _deviceCount) return 0;                         // just return nothing if invalid
+  volatile CubigelHealthType &health = devices[idx].health;  // Reference to health state
+  interruptsOff();                                           // Disable interrupts
+  uint8_t flags = health.flags | health.seen;                // Copy the flags
+  if (reset) health.seen = 0;                                // Reset if so desired
+  interruptsOn();                                            // Enable interrupts
+  return flags;
+}  // of method readHealth()
+CubigelHealthReportType CubigelClass::readHealthReport(const uint8_t idx) {
+  /*!
+  @brief     return the learned current for each speed band and the scores behind the health flags
+  @details   The state is copied again if the interrupt changed it during the copy, and the raw
+             currents are converted to milliamps afterwards. Nothing is reset
+  @param[in] idx Index to device array
+  @return    CubigelHealthReportType structure, all zero if the index is invalid
+  */
+  CubigelHealthReportType report = {};                     // Everything zero by default
+  if (idx >= _deviceCount) return report;                  // just return nothing if invalid
+  volatile CubigelDataType &  device = devices[idx];       // Reference to device storage
+  volatile CubigelHealthType &health = device.health;      // Health state
+  CubigelHealthType           copy;                        // Raw copy of the state
+  uint8_t                     sequence;                    // Sequence number before the copy
+  do {                                                     // Repeat until the interrupt didn't
+    sequence        = device.sequence;                     // change the values during the copy
+    copy.deviation  = health.deviation;                    //
+    copy.startScore = health.startScore;                   //
+    copy.cycleScore = health.cycleScore;                   //
+    copy.flags      = health.flags;                        //
+    copy.seen       = health.seen;                         //
+    for (uint8_t i = 0; i < CUBIGEL_HEALTH_BANDS; ++i) {   //
+      copy.baseline[i] = health.baseline[i];               //
+      copy.learned[i]  = health.learned[i];                //
+    }                                                      // of for-next each speed band
+  } while ((sequence & 1) || sequence != device.sequence);
+  report.flags      = copy.flags;                          // Convert outside of the loop
+  report.seen       = copy.seen;                           //
+  report.startScore = copy.startScore;                     //
+  report.cycleScore = copy.cycleScore;                     //
+  for (uint8_t i = 0; i < CUBIGEL_HEALTH_BANDS; ++i) {     // Only bands which have been learned
+    if (copy.learned[i] >= CUBIGEL_HEALTH_LEARN) report.baselinemA[i] = cubigelmA(copy.baseline[i]);
+  }                                                        // of for-next each speed band
+  report.deviationmA = copy.deviation < 0 ? -(int16_t)cubigelmA(-(int32_t)copy.deviation)
+                                          : (int16_t)cubigelmA(copy.deviation);
+  return report;
+}  // of method readHealthReport()
+void CubigelClass::resetHealth(const uint8_t idx) {
+  /*!
+  @brief     forget the learned currents and scores of a device and start the health check again,
+             e.g. after the compressor has been serviced or replaced
+  @param[in] idx Index to device array
+  @return    void
+  */
+  if (idx >= _deviceCount) return;                           // just return nothing if invalid
+  volatile CubigelHealthType &health = devices[idx].health;  // Reference to health state
+  interruptsOff();                                           // Disable interrupts while changing
+  for (uint8_t i = 0; i < CUBIGEL_HEALTH_BANDS; ++i) {       // Forget every speed band
+    health.baseline[i] = 0;                                  //
+    health.learned[i]  = 0;                                  //
+  }                                                          // of for-next each speed band
+  health.deviation  = 0;                                     //
+  health.startScore = 0;                                     //
+  health.cycleScore = 0;                                     //
+  health.flags      = 0;                                     //
+  health.seen       = 0;                                     //
+  interruptsOn();                                            // Enable interrupts
+}  // of method resetHealth()
+void CubigelClass::interruptsOff() {
+  /*!
+  @brief   disable interrupts for a short read or change of values shared with the interrupt
+  @details The status register is saved first so that interruptsOn() puts back whatever the caller
+           had, like ATOMIC_RESTORESTATE. When compiled with CUBIGEL_PROFILE the time is noted so
+           that interruptsOn() can measure how long they were off
+  @return  void
+  */
+#if defined(__AVR__)
+  uint8_t state = SREG;  // Interrupt flag of the caller
+  cli();                 // Disable interrupts
+  _interruptState = state;
+#else
+  noInterrupts();  // Disable interrupts
+#endif
+#if defined(CUBIGEL_PROFILE)
+  profileOffStart = CUBIGEL_PROFILE_CLOCK();  // Note when
+#endif
+}  // of method interruptsOff()
+void CubigelClass::interruptsOn() {
+  /*!
+  @brief   restore the interrupt state saved by interruptsOff()
+  @details Interrupts are only enabled again if they were enabled when interruptsOff() was called.
+           When compiled with CUBIGEL_PROFILE the longest time interrupts were off is kept
+  @return  void
+  */
+#if defined(CUBIGEL_PROFILE)
+  uint32_t elapsed = CUBIGEL_PROFILE_CLOCK() - profileOffStart;  // Time interrupts were off
+  if (elapsed > profileMaxOff) profileMaxOff = elapsed;          // Keep the longest
+#endif
+#if defined(__AVR__)
+  SREG = _interruptState;  // Restore the caller's interrupt flag
+#else
+  interrupts();  // Enable interrupts
+#endif
+}  // of method interruptsOn()
+CubigelProfileType CubigelClass::readProfile(const bool reset) {
+  /*!
+  @brief     return the timer tick and interrupts off timings, only measured when compiled with
+             CUBIGEL_PROFILE
+  @details   The times are in units of CUBIGEL_PROFILE_NS nanoseconds, so microseconds on an
+             Arduino, where micros() only changes every 4us. The time taken by micros() itself is
+             included, which on a 16MHz AVR is a few microseconds per tick. The timings cover every
+             instance, since one timer tick reads them all. The mean is kept in 32 bits: whenever
+             the sum of the tick times would overflow it and its count are halved, which leaves the
+             mean unchanged but gives the ticks after that more weight. With 20us ticks on an AVR
+             that first happens after about 60 hours
+  @param[in] reset optional parameter that doesn't reset the timings when "false". Default true.
+  @return    CubigelProfileType structure, all zeroes if no tick was measured
+  */
+  CubigelProfileType profile = {};  // Structure to return
+#if defined(CUBIGEL_PROFILE)
+  uint32_t total, summed;                                   // Copies for the mean
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {                       // Copy everything in one go
+    profile.busyTicks   = profileBusy;                      //
+    profile.idleTicks   = profileTicks - profileBusy;       //
+    profile.minTime     = profileTicks ? profileMin : 0;    //
+    profile.maxTime     = profileMax;                       //
+    total               = profileTotal;                     //
+    summed              = profileSummed;                    //
+    profile.maxByteTime = profileMaxByte;                   //
+    profile.maxOffTime  = profileMaxOff;                    //
+    if (reset) {                                            // Start again if so desired
+      profileTicks   = 0;                                   //
+      profileBusy    = 0;                                   //
+      profileMin     = UINT32_MAX;                          //
+      profileMax     = 0;                                   //
+      profileTotal   = 0;                                   //
+      profileSummed  = 0;                                   //
+      profileMaxByte = 0;                                   //
+      profileMaxOff  = 0;                                   //
+    }                                                       // of if-then reset the timings
+  }                                                         // of ATOMIC_BLOCK
+  if (summed) profile.meanTime = total / summed;            // Divide with interrupts on
+#else
+  (void)reset;  // Nothing is measured without the flag
+#endif
+  return profile;
+}  // of method readProfile()
+bool CubigelClass::setHistory(const uint8_t idx, CubigelSampleType *buffer, uint8_t size) {
+  /*!
+  @brief     set the ring buffer used to store each decoded type 76 sentence for a device
+  @details   The buffer belongs to the calling program and must stay valid while it is in use; one
+             entry is always kept free, so the buffer holds up to "size - 1" samples. Any samples
+             in a previous buffer are discarded. Passing a nullptr or a size below 2 turns the
+             history off
+  @param[in] idx    Index to device array
+  @param[in] buffer Array of "size" samples
+  @param[in] size   Number of entries in the array
+  @return    false if the device index is invalid
+  */
+  if (idx >= _deviceCount) return false;             // just return nothing if invalid
+  if (buffer == nullptr || size < 2) size = 0;       // Turn the history off
+  volatile CubigelDataType &device = devices[idx];   // Reference to device storage
+  interruptsOff();                                   // Disable interrupts while changing
+  device.history     = size ? buffer : nullptr;      // Set the new buffer and empty it
+  device.historySize = size;                         //
+  device.historyHead = 0;                            //
+  device.historyTail = 0;                            //
+  interruptsOn();                                    // Enable interrupts
+  return true;
+}  // of method setHistory()
+uint8_t CubigelClass::readHistory(const uint8_t idx, CubigelSampleType *samples,
+                                  const uint8_t maxSamples) {
+  /*!
+  @brief      copy the oldest waiting history samples for a device into the caller's array
+  @details    The samples are copied oldest first and then released in one step by moving the tail
+              index, so the interrupt can keep adding samples while this is running
+  @param[in]  idx        Index to device array
+  @param[out] samples    Array for at least "maxSamples" samples
+  @param[in]  maxSamples Maximum number of samples to copy
+  @return     Number of samples copied, 0 if none are waiting or the index is invalid
+  */
+  if (idx >= _deviceCount) return 0;                       // just return nothing if invalid
+  volatile CubigelDataType &device = devices[idx];         // Reference to device storage
+  uint8_t                   size   = device.historySize;   // Ring buffer size
+  uint8_t                   head   = device.historyHead;   // Samples up to here are complete
+  uint8_t                   tail   = device.historyTail;   // Oldest sample waiting
+  uint8_t                   count  = 0;                    // Samples copied
+  while (tail != head && count < maxSamples) {             // Copy each waiting sample
+    volatile CubigelSampleType &sample = device.history[tail];
+    samples[count].time  = sample.time;                    //
+    samples[count].RPM   = sample.RPM;                     //
+    samples[count].mA    = sample.mA;                      //
+    samples[count].alarm = sample.alarm;                   //
+    ++count;                                               //
+    if (++tail == size) tail = 0;                          // Wrap around at the end
+  }                                                        // of while-loop samples to copy
+  device.historyTail = tail;                               // Release the copied entries
+  return count;
+}  // of method readHistory()
+uint16_t CubigelClass::readHistoryDropped(const uint8_t idx, const bool reset) {
+  /*!
+  @brief     return the number of samples discarded because a device's history buffer was full, in
+             which case readHistory() isn't called often enough or the buffer needs to be larger
+  @param[in] idx Index to device array
+  @param[in] reset optional parameter that resets the counter when "true". Default false.
+  @return    Number of samples, stops at 65535
+  */
+  if (idx >= _deviceCount) return 0;                 // just return nothing if invalid
+  volatile CubigelDataType &device = devices[idx];   // Reference to device storage
+  uint8_t                   sequence;                // Sequence number before the copy
+  uint16_t                  dropped;                 // Copy of the count
+  if (reset) interruptsOff();                        // Nothing may change until cleared
+  do {                                               // Repeat until the interrupt didn't
+    sequence = device.sequence;                      // change the value during the copy
+    dropped  = device.historyDropped;                //
+  } while ((sequence & 1) || sequence != device.sequence);
+  if (reset) {                                       // Clear the counter
+    device.historyDropped = 0;                       //
+    interruptsOn();                                  // Enable interrupts
+  }                                                  // of if-then reset the counter
+  return dropped;
+}  // of method readHistoryDropped()
 uint16_t CubigelClass::readValues(const uint8_t idx, uint16_t &RPM, uint16_t &mA,
                                   const bool resetReadings) {
   /*!
@@ -165,196 +967,563 @@ uint16_t CubigelClass::readValues(const uint8_t idx, uint16_t &RPM, uint16_t &mA
   true.
   @return Number of readings
   */
-  if (idx >= _deviceCount) return 0;                    // just return nothing if invalid
-  cli();                                                // Disable interrupts
-  RPM = devices[idx].totalRPM / devices[idx].readings;  // set the averaged RPM value
-  mA  = devices[idx].totalmA / devices[idx].readings;   // set the averaged mA value
-  uint16_t tempReadings = devices[idx].readings;        // copy the readings value
-  if (resetReadings) {                                  // Reset the readings if so desired
-    devices[idx].readings    = 0;                       // Set back to 0
-    devices[idx].totalRPM    = 0;                       // Set back to 0
-    devices[idx].totalmA     = 0;                       // Set back to 0
-    devices[idx].errorStatus = 0;                       // Set back to 0
-    devices[idx].commsErrors = 0;                       // Set back to 0
-  }                                                     // of if-then values are to be reset
-  sei();                                                // Enable interrupts
-  return tempReadings;                                  // Return the number of readings
+  uint16_t commsErrors, errorStatus;  // Values which aren't returned
+  return readValues(idx, RPM, mA, commsErrors, errorStatus, resetReadings);
 }  // of method readValues
 uint16_t CubigelClass::readValues(const uint8_t idx, uint16_t &RPM, uint16_t &mA,
-                                  uint16_t &commsErrors, uint16_t errorStatus,
+                                  uint16_t &commsErrors, uint16_t &errorStatus,
                                   const bool resetReadings) {
   /*!
     @brief   called to process the collected readings
     @details The return value is the number of readings taken and the parameters are updated (pass
              by reference) with the current value. The default settings is that the statistics are
              reset after this call, but the optional resetReading parameter can override this
-    setting
+             setting. The statistics are copied without disabling interrupts and the averages are
+             computed from the copy. A mode command waiting for a port without a transmit buffer,
+             such as SoftwareSerial, is sent here in full since the interrupt doesn't write to those
+             ports; at 1200 baud that takes up to 58ms
     @param[in] idx Index to device array
     @param[in] RPM Return average RPM
     @param[in] mA  Return average milliamps
-    @param[in] commsErrors
-    @param[in] errorStatus
+    @param[out] commsErrors Return number of communications errors
+    @param[out] errorStatus Return OR'd Cubigel alarm codes
     @param[in] resetReadings optional parameter that doesn't reset readings when "false". Default
     true.
     @return Number of readings
   */
-  if (idx >= _deviceCount) return 0;                            // just return nothing if invalid
-  cli();                                                        // Disable interrupts
-  RPM         = devices[idx].totalRPM / devices[idx].readings;  // set the averaged RPM value
-  mA          = devices[idx].totalmA / devices[idx].readings;   // set the averaged mA value
-  commsErrors = devices[idx].commsErrors;                       // set the number of comms errors
-  errorStatus = devices[idx].errorStatus;                       // set the Cubigel error status
-  uint16_t tempReadings = devices[idx].readings;                // copy the readings value
-  if (resetReadings) {                                          // Reset the readings if so desired
-    devices[idx].readings    = 0;                               // Set back to 0
-    devices[idx].totalRPM    = 0;                               // Set back to 0
-    devices[idx].totalmA     = 0;                               // Set back to 0
-    devices[idx].errorStatus = 0;                               // Set back to 0
-    devices[idx].commsErrors = 0;                               // Set back to 0
-  }                                                             // of if-then values are to be reset
-  sei();                                                        // Enable interrupts
-  return tempReadings;                                          // Return the number of readings
+  CubigelStatisticsType stats;                                   // Copy of the statistics
+  if (!snapshotStatistics(idx, stats, resetReadings)) return 0;  // just return nothing if invalid
+  if (!(devices[idx].flags & CUBIGEL_PORT_BUFFERED)) {           // The interrupt doesn't write to
+    transmit(idx, CUBIGEL_COMMAND_BYTES);                        // this port, so send the command
+  }                                                              // of if-then unbuffered port
+  if (stats.readings) {                                          // Only average with readings
+    RPM = stats.totalRPM / stats.readings;                       // set the averaged RPM value
+    mA  = cubigelmA(stats.totalRawmA / stats.readings);          // set the averaged mA value
+  } else {                                                       // otherwise there is nothing to
+    RPM = 0;                                                     // average, so return zeroes
+    mA  = 0;                                                     //
+  }                                                              // of if-then-else we have readings
+  commsErrors = stats.commsErrors;                               // set the number of comms errors
+  errorStatus = stats.errorStatus;                               // set the Cubigel error status
+  return stats.readings;                                         // Return the number of readings
 }  // of method readValues
+static void copyStatistics(CubigelStatisticsType &to, const volatile CubigelStatisticsType &from) {
+  /*!
+    @brief      Copy a volatile statistics block field by field
+    @param[out] to   Copy of the statistics
+    @param[in]  from Statistics block to copy
+  */
+  to.readings     = from.readings;
+  to.running      = from.running;
+  to.totalRPM     = from.totalRPM;
+  to.totalRawmA   = from.totalRawmA;
+  to.squaresRPM   = from.squaresRPM;
+  to.squaresRawmA = from.squaresRawmA;
+  to.refRPM       = from.refRPM;
+  to.refRawmA     = from.refRawmA;
+  to.minRPM       = from.minRPM;
+  to.maxRPM       = from.maxRPM;
+  to.minRawmA     = from.minRawmA;
+  to.maxRawmA     = from.maxRawmA;
+  to.errorStatus  = from.errorStatus;
+  to.commsErrors  = from.commsErrors;
+}  // of function copyStatistics()
+static uint32_t scaleRaw(const uint32_t value) {
+  /*!
+    @brief     Multiply a 32 bit value by CUBIGEL_MA_SCALE / CUBIGEL_MA_RAW
+    @details   Split into the whole and remaining raw units so that neither product needs more than
+               32 bits, rounding down the same as a single division would
+    @param[in] value Value in raw current units
+    @return    Value in milliamps
+  */
+  return value / CUBIGEL_MA_RAW * CUBIGEL_MA_SCALE +
+         value % CUBIGEL_MA_RAW * CUBIGEL_MA_SCALE / CUBIGEL_MA_RAW;
+}  // of function scaleRaw()
+static uint32_t variance(const uint16_t count, const uint32_t total, const uint16_t reference,
+                         const uint32_t squares) {
+  /*!
+    @brief     Compute a variance from the count, sum and sum of squared differences from a
+               reference value of a set of values
+    @details   Uses (squares - sum*sum/count) / count, where sum is the sum of the differences from
+               the reference. The square of that sum can be larger than 32 bits, so sum*sum/count
+               is worked out from the quotient and remainder of sum/count, which keeps all of the
+               products within 32 bits and avoids a 64 bit division. The result is never negative
+               since the sum of squares is always at least sum*sum/count
+    @param[in] count     Number of values
+    @param[in] total     Sum of the values
+    @param[in] reference Value the differences were taken from
+    @param[in] squares   Sum of the squared differences, UINT32_MAX if it stopped
+    @return    Population variance, 0 when there are no values and UINT32_MAX when unknown
+  */
+  if (count == 0) return 0;                       // No values, no variance
+  if (squares == UINT32_MAX) return UINT32_MAX;   // The sum stopped, so the spread is unknown
+  uint32_t offset = (uint32_t)count * reference;  // Reference added count times
+  uint32_t sum    = total > offset ? total - offset : offset - total;  // Size of the differences
+  uint32_t whole  = sum / count;                                       // sum = whole * count
+  uint32_t part   = sum % count;                                       // + part
+  uint32_t square = whole * sum + whole * part + part * part / count;  // sum * sum / count
+  return (squares - square) / count;
+}  // of function variance()
+CubigelSummaryType CubigelClass::readStatistics(const uint8_t idx, const bool reset) {
+  /*!
+    @brief     return the averages, lowest and highest values and variances of the RPM and mA
+               readings since the last reset
+    @details   Unlike readValues(), which averages over all readings including those where the
+               compressor was off, these values only cover the readings where it was running. All
+               of the division is done here rather than in the interrupt. When a sum of squares has
+               filled up "saturated" is set and that variance is UINT32_MAX
+    @param[in] idx   Index to device array
+    @param[in] reset optional parameter that doesn't reset readings when "false". Default true.
+    @return    Summary of the statistics, all zero if the index is invalid
+  */
+  CubigelSummaryType    summary = {};                     // Everything zero by default
+  CubigelStatisticsType stats;                            // Copy of the statistics
+  if (!snapshotStatistics(idx, stats, reset)) return summary;  // just return nothing if invalid
+  summary.readings    = stats.readings;                   // Copy the counts
+  summary.running     = stats.running;                    //
+  summary.errorStatus = stats.errorStatus;                //
+  summary.commsErrors = stats.commsErrors;                //
+  if (stats.running) {                                    // Only compute if there are values
+    summary.RPM         = stats.totalRPM / stats.running;  // Averages
+    summary.mA          = cubigelmA(stats.totalRawmA / stats.running);  // converted once
+    summary.minRPM      = stats.minRPM;                    // Lowest and highest values
+    summary.maxRPM      = stats.maxRPM;                    //
+    summary.minmA       = cubigelmA(stats.minRawmA);       //
+    summary.maxmA       = cubigelmA(stats.maxRawmA);       //
+    summary.varianceRPM = variance(stats.running, stats.totalRPM, stats.refRPM, stats.squaresRPM);
+    uint32_t rawVariance =
+        variance(stats.running, stats.totalRawmA, stats.refRawmA, stats.squaresRawmA);
+    summary.variancemA = rawVariance == UINT32_MAX ? UINT32_MAX
+                                                   : scaleRaw(scaleRaw(rawVariance));  // Squared
+    summary.saturated  = summary.varianceRPM == UINT32_MAX || rawVariance == UINT32_MAX;
+  }  // of if-then the compressor was running
+  return summary;
+}  // of method readStatistics()
+bool CubigelClass::snapshotStatistics(const uint8_t idx, CubigelStatisticsType &stats,
+                                      const bool reset) {
+  /*!
+    @brief      copy a device's statistics without disabling interrupts
+    @details    When resetting, the interrupt is switched to the other (empty) block by writing the
+                single "active" byte. From then on the interrupt no longer touches the old block,
+                so it can be copied and cleared for the next switch. Otherwise the active block is
+                copied and the copy is repeated if the interrupt changed the sequence number while
+                it was being made
+    @param[in]  idx   Index to device array
+    @param[out] stats Copy of the statistics
+    @param[in]  reset Start a new set of statistics when true
+    @return     false if the device index is invalid
+  */
+  if (idx >= _deviceCount) return false;                    // just return nothing if invalid
+  volatile CubigelDataType &device = devices[idx];          // Reference to device storage
+  if (reset) {                                              // Switch blocks and read the old one
+    uint8_t old   = device.active;                          // Block the interrupt was using
+    device.active = old ^ 1;                                // Interrupt now uses the other one
+    volatile CubigelStatisticsType &block = device.stats[old];
+    copyStatistics(stats, block);                           // Copy the values
+    block.readings     = 0;                                 // Set back to 0 ready for the next
+    block.running      = 0;                                 // switch. The lowest and highest
+    block.totalRPM     = 0;                                 // values are set by the first
+    block.totalRawmA   = 0;                                 // running reading, as are the
+    block.squaresRPM   = 0;                                 // references, so don't need to be
+    block.squaresRawmA = 0;                                 // cleared
+    block.errorStatus  = 0;                                 //
+    block.commsErrors  = 0;                                 //
+    settings[idx].resetTime = millis();                     // Next statistics start now
+  } else {                                                  // Copy the active block
+    uint8_t sequence;                                       // Sequence number before the copy
+    do {                                                    // Repeat until the interrupt didn't
+      sequence = device.sequence;                           // change the values during the copy
+      copyStatistics(stats, device.stats[device.active]);   //
+    } while ((sequence & 1) || sequence != device.sequence);
+  }  // of if-then-else reset the statistics
+  return true;
+}  // of method snapshotStatistics()
 void CubigelClass::setMode(const uint8_t idx, const uint8_t mode) {
   /*!
     @brief   called to set which mode the Cubigel outputs data in
     @details The default mode, MODE_DEFAULT, outputs the message type 76 which contains the
-             compressor speed and current consumption.
+             compressor speed and current consumption. The command isn't written here, it is put
+             into the device's transmit queue and sent by transmit(). If a command is already
+             being sent this one follows it, replacing any other that was waiting since only the
+             last mode set matters. This is called both from the interrupt and by the program, so
+             the queue is changed with interrupts disabled
     @param[in] idx Index to device array
-    @param[in] mode
+    @param[in] mode MODE_DEFAULT or MODE_SETTINGS
     @return void
   */
-  uint8_t modeByte = 0;                         // Byte to set state, default is 0
-  if (mode == 1) modeByte = 192;                // Mode 0 is the default
-  if (idx >= _deviceCount) return;              // just return nothing if invalid
-  if (devices[idx].serialSW) {                  // if we are using software serial,
-    devices[idx].serialSW->write((uint8_t)72);  // Write control information
-    devices[idx].serialSW->write((uint8_t)80);  // Write control information
-    devices[idx].serialSW->write(modeByte);     // Write control type byte
-    devices[idx].serialSW->write((uint8_t)0);   // Write control information
-    devices[idx].serialSW->write((uint8_t)0);   // Write control information
-    devices[idx].serialSW->write((uint8_t)0);   // Write control information
-    devices[idx].serialSW->write((uint8_t)15);  // Write control information
-  } else {
-    devices[idx].serialHW->write((uint8_t)72);  // Write control information
-    devices[idx].serialHW->write((uint8_t)80);  // Write control information
-    devices[idx].serialHW->write(modeByte);     // Write control type byte
-    devices[idx].serialHW->write((uint8_t)0);   // Write control information
-    devices[idx].serialHW->write((uint8_t)0);   // Write control information
-    devices[idx].serialHW->write((uint8_t)0);   // Write control information
-    devices[idx].serialHW->write((uint8_t)15);  // Write control information
-  }  // of if-then-else software or hardware serial is use
+  uint8_t modeByte = 0;                             // Byte to set state, default is 0
+  if (mode == 1) modeByte = 192;                    // Mode 0 is the default
+  if (idx >= _deviceCount) return;                  // just return nothing if invalid
+  volatile CubigelDataType &device = devices[idx];  // Reference to device storage
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {               // Interrupts off, restored afterwards
+    CUBIGEL_PROFILE_OFF();                          // Timed with CUBIGEL_PROFILE
+    if (device.txIndex < CUBIGEL_COMMAND_BYTES) {   // A command is being sent, so queue
+      device.txNext = modeByte;                     // this one to follow it
+    } else {                                        // otherwise start sending it
+      device.txMode  = modeByte;                    //
+      device.txIndex = 0;                           //
+    }                                               // of if-then-else command being sent
+  }                                                 // of atomic block
 }  // of method setMode()
-void CubigelClass::processDevice(const uint8_t idx) {
+void CubigelClass::transmit(const uint8_t idx, const uint8_t limit) {
   /*!
-  @brief   is called when there is data received on the port for a specific device
-  @details The device number is passed in as a parameter and the rest of the logic is independent
-           of which device it is
-  @param[in] idx Index to device array
-  @return void
+    @brief   send as many bytes of a waiting mode command as the port can take without waiting
+    @details A hardware port takes as many bytes as there is room for in its transmit buffer, so
+             normally the whole command at once, and is sent to from the timer tick, poll() and
+             onReceive(). Other ports don't say how much room they have and a SoftwareSerial write
+             busy-waits for the whole byte, so they are only written from the program by poll()
+             and readValues(), "limit" bytes per call. The queue is updated with interrupts
+             disabled since setMode() may be adding a command from the interrupt at the same time
+    @param[in] idx   Index to device array
+    @param[in] limit Bytes written to a port without a transmit buffer. Default is 1
+    @return void
+  */
+  static const uint8_t command[CUBIGEL_COMMAND_BYTES] = {72, 80, 0, 0, 0, 0, 15};  // Mode command
+  volatile CubigelDataType &device = devices[idx];  // Reference to device storage
+  uint8_t index = device.txIndex;               // Next byte to send
+  if (index >= CUBIGEL_COMMAND_BYTES) return;   // Nothing to send
+  Stream *port = device.port;                   // Port for the device
+  int     room = limit;                         // Bytes the port can take
+  if (device.flags & CUBIGEL_PORT_BUFFERED) room = port->availableForWrite();
+  for (; room > 0 && index < CUBIGEL_COMMAND_BYTES; --room, ++index) {  // Send what fits
+    port->write(index == 2 ? (uint8_t)device.txMode : command[index]);  // Byte 2 is the mode
+  }                                             // of for-next each byte sent
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {           // Interrupts off, restored afterwards
+    CUBIGEL_PROFILE_OFF();                      // Timed with CUBIGEL_PROFILE
+    if (index == CUBIGEL_COMMAND_BYTES && device.txNext != CUBIGEL_NO_COMMAND) {  // Command done,
+      device.txMode = device.txNext;            // start the one waiting
+      device.txNext = CUBIGEL_NO_COMMAND;       //
+      index         = 0;                        //
+    }                                           // of if-then start the next command
+    device.txIndex = index;                     // Bytes sent so far
+  }                                             // of atomic block
+}  // of method transmit()
+uint8_t CubigelClass::processDevice(const uint8_t idx, const uint8_t limit) {
+  /*!
+  @brief     is called when there is data received on the port for a specific device
+  @details   The device number is passed in as a parameter and the rest of the logic is independent
+             of which device it is. The byte read is passed to the device's parser, and any bytes
+             which the parser needs to re-read after a failed checksum are processed before the
+             next byte from the port so that it continues in the right place. No more than "limit"
+             bytes are run through the parser; a replay which is cut short is carried on with by
+             the next call instead of reading the port. When compiled with CUBIGEL_PROFILE the
+             longest call is kept, whichever mode the port is read in
+  @param[in] idx   Index to device array
+  @param[in] limit Maximum bytes to run through the parser, at least 1. Default is all of them
+  @return    Number of bytes run through the parser, including the replayed ones
 */
-  if (devices[idx].serialSW) {  // if we are using software serial,
-    devices[idx].buffer[devices[idx].index++] =
-        devices[idx].serialSW->read();  // Read next byte into buffer
-  } else {
-    devices[idx].buffer[devices[idx].index++] =
-        devices[idx].serialHW->read();  // Read next byte into buffer
-  }                                     // of if-then-else software or hardware serial is use
-  if ((devices[idx].index == 1 &&
-       devices[idx].buffer[0] != 27) ||  // If the first byte isn't a 27 and
-      (devices[idx].index == 2 &&
-       !(devices[idx].buffer[1] == 76 ||    // the 2nd byte neither 76 nor 80
-         devices[idx].buffer[1] == 80))) {  // then reset the index to beginning
-    devices[idx].index = 0;                 // 27 then reset the index
-    devices[idx].commsErrors++;             // increment the error counter
-  } else {                                  // otherwise check next character
-    if (devices[idx].buffer[1] == 76 &&
-        devices[idx].index == 8) {                               // We have a complete 76 sentence
-      if ((devices[idx].buffer[0] ^ devices[idx].buffer[2] ^     // Two checksums are made with XOR
-           devices[idx].buffer[4]) == devices[idx].buffer[6] &&  // from bytes 0,2,4 and 1,3,5 to
-          (devices[idx].buffer[1] ^ devices[idx].buffer[3] ^     // match bytes 6 and 7 respectively
-           devices[idx].buffer[5]) == devices[idx].buffer[7]) {  // Ignore sentence on bad checksum
-        devices[idx].readings++;                                 // increment the counter
-        if (devices[idx].offTime >= devices[idx].onTime &&
-            devices[idx].buffer[2] != 0) {      // Set the off and on times
-          devices[idx].onTime      = millis();  // when state of compressor changes
-          devices[idx].timeChanged = true;      // Set the change flag
-        } else {                                //
-          if (devices[idx].onTime >= devices[idx].offTime &&
-              devices[idx].buffer[2] == 0) {      // Set the off and on times
-            devices[idx].offTime     = millis();  // then set the time and
-            devices[idx].timeChanged = true;      // Set the change flag
-          }                                       // of if-then the device turned off
-        }                                         // of if-then the device turned on
-        if (devices[idx].buffer[2] != 0) {        // Compressor running if non-zero
-          devices[idx].totalRPM +=
-              (devices[idx].buffer[2] * 256) + devices[idx].buffer[3];  // Add in RPM
-          devices[idx].totalmA +=
-              ((uint32_t)devices[idx].buffer[4] * 256 + devices[idx].buffer[5]) * 1000 /
-              3160;                                            // mA
-        } else {                                               // otherwise system off, check for
-          devices[idx].errorStatus |= devices[idx].buffer[5];  // OR the alarm codes together
-        }                                                      // of if-then-else the fridge is on
-      } else {
-        devices[idx].commsErrors++;  // Add to number of errors detected
-      }                              // of if-then-else checksums match
-      devices[idx].index = 0;        // Reset index for next frame
-    } else {
-      if (devices[idx].buffer[1] == 80 &&
-          devices[idx].index == 22) {                            // We have a complete 80 sentence
-        if ((72 ^ devices[idx].buffer[2] ^                       // Two checksums are made by XORing
-             devices[idx].buffer[4] ^ devices[idx].buffer[6] ^   // all the odd bytes and the even
-             devices[idx].buffer[8] ^ devices[idx].buffer[10] ^  // bytes to compare to the last 2
-             devices[idx].buffer[12] ^ devices[idx].buffer[14] ^  // sentence values. Note that the
-             devices[idx].buffer[16] ^ devices[idx].buffer[18])  // initial byte is "72" and not the
-                == devices[idx].buffer[20] &&                    // actual 27 for purposes of check-
-            (devices[idx].buffer[1] ^ devices[idx].buffer[3] ^   // sum computation
-             devices[idx].buffer[5] ^ devices[idx].buffer[7] ^ devices[idx].buffer[9] ^
-             devices[idx].buffer[11] ^ devices[idx].buffer[13] ^ devices[idx].buffer[15] ^
-             devices[idx].buffer[17] ^ devices[idx].buffer[19]) == devices[idx].buffer[21]) {
-          devices[idx].minSpeed =
-              devices[idx].buffer[2] * 256 + devices[idx].buffer[3];  // Get minimum RPM
-          devices[idx].maxSpeed =
-              devices[idx].buffer[4] * 256 + devices[idx].buffer[5];  // Get maximum RPM
-          devices[idx].cutOut12V =
-              ((uint32_t)devices[idx].buffer[8] * 256 + devices[idx].buffer[9]) * 1000 /
-              1187;  // 12V cutout volts
-          devices[idx].cutIn12V =
-              ((uint32_t)devices[idx].buffer[10] * 256 + devices[idx].buffer[11]) * 1000 /
-              1187;  // 12V cutin volts
-          devices[idx].cutOut24V =
-              ((uint32_t)devices[idx].buffer[12] * 256 + devices[idx].buffer[13]) * 1000 /
-              1187;  // 24V cutout volts
-          devices[idx].cutIn24V =
-              ((uint32_t)devices[idx].buffer[14] * 256 + devices[idx].buffer[15]) * 1000 /
-              1187;  // 24V cutin volts
-          devices[idx].cutOut42V =
-              ((uint32_t)devices[idx].buffer[16] * 256 + devices[idx].buffer[17]) * 1000 /
-              1187;  // 42V cutout volts
-          devices[idx].cutIn42V =
-              ((uint32_t)devices[idx].buffer[18] * 256 + devices[idx].buffer[19]) * 1000 /
-              1187;                                        // 42V cutin volts
-          devices[idx].modeByte = devices[idx].buffer[7];  // Save bit register settings
-          setMode(idx, MODE_DEFAULT);                      // Reset device to default mode
-        }                        // of if-then the checksum computation was successful
-        devices[idx].index = 0;  // Reset index for next frame
-      }                          // of if-then we have a type 80 sentence
-    }                            // of if-then we have a complete sentence
-  }                              // of if-then-else we are at the first byte
+#if defined(CUBIGEL_PROFILE)
+  uint32_t start = CUBIGEL_PROFILE_CLOCK();  // Start of the call
+#endif
+  CubigelParser &parser = parsers[idx];  // Parser state is only used here, so not volatile
+  uint8_t        steps  = 0;             // Bytes run through the parser
+  if (!parser.pending()) {                              // Nothing left to replay, so
+    uint8_t value  = devices[idx].port->read();         // read the next byte from the port
+    uint8_t status = parser.parse(value);               // Parse it
+    if (_captureSize) captureByte(idx, value, status);  // and log it if capturing
+    if (status != CUBIGEL_PARSE_BUSY) storeSentence(idx, status);
+    steps = 1;                                          //
+  }                                                     // of if-then read a new byte
+  while (steps < limit && parser.pending()) {           // Replay bytes while allowed
+    uint8_t status = parser.resume();                   // Process the next one
+    if (status != CUBIGEL_PARSE_BUSY) storeSentence(idx, status);
+    ++steps;                                            //
+  }                                                     // of while-loop bytes to replay
+#if defined(CUBIGEL_PROFILE)
+  uint32_t elapsed = CUBIGEL_PROFILE_CLOCK() - start;      // Length of the call
+  if (elapsed > profileMaxByte) profileMaxByte = elapsed;  // Keep the longest
+#endif
+  return steps;
 }  // of method ProcessDevice
+static uint32_t addSquare(const uint32_t squares, const uint16_t value, const uint16_t reference) {
+  /*!
+    @brief     Add the square of a value's difference from a reference to a sum of squares
+    @param[in] squares   Sum so far
+    @param[in] value     Value to add
+    @param[in] reference Value the difference is taken from
+    @return    New sum, which stops at UINT32_MAX instead of wrapping around
+  */
+  uint16_t difference = value > reference ? value - reference : reference - value;
+  uint32_t square     = (uint32_t)difference * difference;
+  return squares > UINT32_MAX - square ? UINT32_MAX : squares + square;
+}  // of function addSquare()
+static uint32_t rebaseSquares(const uint32_t squares, const uint32_t total, const uint8_t shift,
+                              uint16_t &reference) {
+  /*!
+    @brief     Move the reference of a sum of squares of n = 2^shift values to their average,
+               rounded down
+    @details   With S the sum of the differences from the old reference, the step d = S / n
+               rounded down and e = S - n*d, the sum of the squares of the differences from the new
+               reference is squares - n*d*d - 2d*e. Dividing by n is a shift, and since the new sum
+               fits in 32 bits the unsigned arithmetic gives it exactly even if a term wraps. The
+               new sum can only be larger than the old one by less than n, so a sum that close to
+               full is treated as full
+    @param[in]     squares   Sum of the squared differences from the old reference
+    @param[in]     total     Sum of the values
+    @param[in]     shift     Number of values as a power of two, at most 10
+    @param[in,out] reference Old reference, updated to the new one
+    @return    Sum of the squared differences from the new reference, UINT32_MAX if it was full
+  */
+  uint32_t count = (uint32_t)1 << shift;                            // n
+  if (squares > UINT32_MAX - count) return UINT32_MAX;              // A full sum stays full
+  int32_t  sum  = (int32_t)(total - count * reference);             // S
+  int32_t  step = sum >= 0 ? sum >> shift : -((count - 1 - sum) >> shift);  // d, rounded down
+  uint32_t rest = (uint32_t)(sum - step * (int32_t)count);          // e, 0 to n - 1
+  uint32_t size = (uint32_t)(step < 0 ? -step : step);              // Size of the step
+  uint32_t drop = count * size * size;                              // n*d*d
+  uint32_t skew = 2 * size * rest;                                  // Size of 2d*e
+  reference     = reference + step;                                 // New reference
+  return step >= 0 ? squares - drop - skew : squares + skew - drop;  // 2d*e is negative if d is
+}  // of function rebaseSquares()
+static const uint16_t kGapLimits[CUBIGEL_GAP_BUCKETS - 1] = {450, 550, 1050, 1550, 2050};  ///< ms
+static const uint16_t kHealthBands[CUBIGEL_HEALTH_BANDS - 1] = {2250, 2750, 3250};         ///< RPM
+void CubigelClass::checkHealth(const uint8_t idx, const uint16_t RPM, const uint16_t rawmA,
+                               const uint8_t alarm, const uint32_t runTime, const uint32_t now) {
+  /*!
+  @brief   is called by storeSentence() with every type 76 sentence to update the health check
+  @details The current is compared with the value learned for the speed band once the compressor
+           has been running for CUBIGEL_HEALTH_SETTLE_MS. The learning uses shifts rather than
+           divisions, and the weight of a new reading halves each time the number of readings
+           doubles, so the first readings give their average and later ones a moving average with
+           a weight of 1/CUBIGEL_HEALTH_LEARN. A failed start doesn't change the short cycle score
+           and a short cycle halves the failed start score, since the compressor did start
+  @param[in] idx     Index to device array
+  @param[in] RPM     Compressor speed, 0 when off
+  @param[in] rawmA   Raw current, 0 when off
+  @param[in] alarm   Alarm code, 0 when running
+  @param[in] runTime Length of the run which has just ended in ms, 0 if the compressor didn't stop
+  @param[in] now     millis() of the sentence
+  @return void
+*/
+  volatile CubigelHealthType &health = devices[idx].health;  // Reference to health state
+  uint8_t flags = health.flags & ~CUBIGEL_HEALTH_ALARM;     // The alarm only comes from this
+  if (alarm) flags |= CUBIGEL_HEALTH_ALARM;                 // sentence
+  if (runTime) {                                            // The compressor has just stopped
+    uint8_t starts = health.startScore;                     // Local copies of the scores
+    uint8_t cycles = health.cycleScore;                     //
+    if (runTime < CUBIGEL_FAILED_START_MS) {                // It didn't really start, or
+      if (starts != UINT8_MAX) ++starts;                    //
+    } else if (runTime < CUBIGEL_SHORT_CYCLE_MS) {          // it stopped again too soon, or
+      if (cycles != UINT8_MAX) ++cycles;                    //
+      starts >>= 1;                                         //
+    } else {                                                // it was a normal run
+      starts >>= 1;                                         //
+      cycles >>= 1;                                         //
+    }                                                       // of if-then-else length of the run
+    health.startScore = starts;                             //
+    health.cycleScore = cycles;                             //
+    flags &= ~(CUBIGEL_HEALTH_STARTS | CUBIGEL_HEALTH_CYCLING);  // Set the flags from the scores
+    if (starts >= CUBIGEL_HEALTH_REPEATS) flags |= CUBIGEL_HEALTH_STARTS;
+    if (cycles >= CUBIGEL_HEALTH_REPEATS) flags |= CUBIGEL_HEALTH_CYCLING;
+  }                                                         // of if-then the compressor stopped
+  if (RPM && now - devices[idx].onTime >= CUBIGEL_HEALTH_SETTLE_MS) {  // Running steadily
+    uint8_t band = 0;                                       // Find the speed band
+    while (band < CUBIGEL_HEALTH_BANDS - 1 && RPM > kHealthBands[band]) ++band;
+    uint16_t baseline   = health.baseline[band];            // Local copies for the band
+    uint8_t  learned    = health.learned[band];             //
+    int32_t  difference = (int32_t)rawmA - baseline;        // Difference from the learned value
+    int32_t  limit      = baseline >> 2;                    // which is allowed, a quarter
+    if (learned < CUBIGEL_HEALTH_LEARN || (difference <= limit && difference >= -limit)) {
+      uint8_t shift = 0;                                    // Weight of the reading is 1/2^shift
+      while ((2U << shift) <= learned + 1U && (2U << shift) <= CUBIGEL_HEALTH_LEARN) ++shift;
+      health.baseline[band] = baseline + (difference >> shift);  // Learn the reading
+      if (learned < CUBIGEL_HEALTH_LEARN) health.learned[band] = learned + 1;
+    }                                                       // of if-then a usual reading
+    if (learned >= CUBIGEL_HEALTH_LEARN) {                  // Compare with the learned value
+      if (difference > INT16_MAX) difference = INT16_MAX;   // Keep within the stored range
+      if (difference < INT16_MIN) difference = INT16_MIN;   //
+      int32_t deviation = health.deviation;                 // Fast average, weight 1/8
+      deviation += (difference - deviation) >> 3;           //
+      health.deviation = deviation;                         //
+      if (deviation > limit || deviation < -limit) {        // Out by more than a quarter
+        flags |= CUBIGEL_HEALTH_CURRENT;                    //
+      } else {                                              //
+        flags &= ~CUBIGEL_HEALTH_CURRENT;                   //
+      }                                                     // of if-then-else current is off
+    }                                                       // of if-then band has been learned
+  }                                                         // of if-then running steadily
+  health.flags = flags;                                     // Store the conditions now and
+  health.seen  = health.seen | flags;                       // add them to those seen
+}  // of method checkHealth()
+void CubigelClass::storeSentence(const uint8_t idx, const uint8_t status) {
+  /*!
+  @brief   is called with the result of a completed or rejected sentence for a device
+  @details Valid sentences are read from the parser's buffer and the device values are updated
+           using local copies, so that each volatile field is written just once per sentence
+  @param[in] idx    Index to device array
+  @param[in] status CubigelParseStatus value from the parser
+  @return void
+*/
+  volatile CubigelDataType &device = devices[idx];          // Reference to device storage
+  const uint8_t *           buffer = parsers[idx].buffer;   // Sentence bytes from the parser
+  volatile CubigelStatisticsType &stats = device.stats[device.active];  // Block being filled
+  volatile CubigelLinkType &link  = device.link;             // Link counters
+  device.sequence = device.sequence + 1;                    // Odd while updating statistics
+  link.bytes      = parsers[idx].bytes();                   // Publish the parser's byte count
+  if (status == CUBIGEL_PARSE_VALUES || status == CUBIGEL_PARSE_SETTINGS) {  // A good sentence
+    if (link.frames != UINT32_MAX) link.frames = link.frames + 1;  // Count it, saturating
+  }                                                         // of if-then a valid sentence
+  if (status == CUBIGEL_PARSE_VALUES) {                     // We have a complete 76 sentence
+    uint32_t now     = millis();                            // Time of the sentence
+    uint16_t RPM     = 0;                                   // Decoded values, zero when the
+    uint16_t rawmA   = 0;                                   // compressor is off
+    uint8_t  alarm   = 0;                                   //
+    stats.readings   = stats.readings + 1;                  // increment the counter
+    uint32_t onTime  = device.onTime;                       // Local copies of the last on and
+    uint32_t offTime = device.offTime;                      // off times
+    uint32_t runTime = 0;                                   // Length of a run which just ended
+    if (offTime >= onTime && buffer[2] != 0) {              // Set the off and on times
+      device.onTime      = now;                             // when state of compressor changes
+      device.transitions = device.transitions + 1;          // Count the change
+      device.cycles      = device.cycles + 1;               // and the start
+      queueEvent(idx, CUBIGEL_TURNED_ON, 0, now);           // and tell the calling program
+    } else if (onTime >= offTime && buffer[2] == 0) {       // Set the off and on times
+      device.offTime     = now;                             // then set the time and
+      device.transitions = device.transitions + 1;          // count the change
+      if (onTime) runTime = now - onTime;                   // Only if it was seen starting
+      queueEvent(idx, CUBIGEL_TURNED_OFF, 0, now);          //
+    }                                                       // of if-then the device turned on/off
+    if (buffer[2] != 0) {                                   // Compressor running if non-zero
+      RPM            = ((uint16_t)buffer[2] << 8) | buffer[3];                       // Speed
+      rawmA          = ((uint16_t)buffer[4] << 8) | buffer[5];  // Current, converted when read
+      uint16_t running = stats.running + 1;                 // Count running readings
+      stats.running    = running;                           //
+      stats.totalRPM   = stats.totalRPM + RPM;              // Add RPM
+      stats.totalRawmA = stats.totalRawmA + rawmA;         // Add current
+      if (running == 1) {                                   // The first reading is the
+        stats.refRPM   = RPM;                               // reference for the squares
+        stats.refRawmA = rawmA;                             //
+      }                                                     // of if-then first running reading
+      stats.squaresRPM   = addSquare(stats.squaresRPM, RPM, stats.refRPM);  // and their squares
+      stats.squaresRawmA = addSquare(stats.squaresRawmA, rawmA, stats.refRawmA);  //
+      if (running >= 4 && running <= CUBIGEL_REBASE_LIMIT && !(running & (running - 1))) {
+        uint8_t shift = 2;                                  // Move the references from the first
+        while ((1U << shift) < running) ++shift;            // reading, which may be a start-up
+        uint16_t reference = stats.refRPM;                  // spike, to the average so far at
+        stats.squaresRPM   = rebaseSquares(stats.squaresRPM, stats.totalRPM, shift, reference);
+        stats.refRPM       = reference;                     // 4, 8, 16 ... running readings
+        reference          = stats.refRawmA;                //
+        stats.squaresRawmA = rebaseSquares(stats.squaresRawmA, stats.totalRawmA, shift, reference);
+        stats.refRawmA     = reference;                     //
+      }                                                     // of if-then time to move them
+      if (running == 1 || RPM < stats.minRPM) stats.minRPM = RPM;  // First reading sets the
+      if (running == 1 || RPM > stats.maxRPM) stats.maxRPM = RPM;  // lowest and highest values,
+      if (running == 1 || rawmA < stats.minRawmA) stats.minRawmA = rawmA;  // then keep track
+      if (running == 1 || rawmA > stats.maxRawmA) stats.maxRawmA = rawmA;  // of them
+    } else {                                                // otherwise system off, check for
+      alarm             = buffer[5];                        // alarm codes and
+      stats.errorStatus = stats.errorStatus | alarm;        // OR the alarm codes together
+    }                                                       // of if-then-else the fridge is on
+    checkHealth(idx, RPM, rawmA, alarm, runTime, now);      // Update the health check
+    if (device.lastFrame) {                                 // Add time since the last sentence
+      uint32_t gap = now - device.lastFrame;                // Milliseconds since then, limited
+      uint8_t  bucket = 0;                                  // Find its histogram bucket
+      while (bucket < CUBIGEL_GAP_BUCKETS - 1 && gap > kGapLimits[bucket]) ++bucket;
+      if (link.gaps[bucket] != UINT16_MAX) link.gaps[bucket] = link.gaps[bucket] + 1;
+      if (gap > CUBIGEL_MAX_FRAME_GAP) gap = CUBIGEL_MAX_FRAME_GAP;  // when sentences were lost
+      uint32_t charge = device.chargePart + (uint32_t)rawmA * gap;  // Charge in raw x ms, carry
+      uint32_t mAh    = device.chargemAh;                   // whole mAh without dividing
+      while (charge >= CUBIGEL_RAW_MS_PER_MAH) {            // 11376000 raw x ms is 1 mAh
+        charge -= CUBIGEL_RAW_MS_PER_MAH;                   //
+        ++mAh;                                              //
+      }                                                     // of while-loop whole mAh
+      device.chargePart = charge;                           //
+      device.chargemAh  = mAh;                              //
+      if (RPM) {                                            // Add the time to the running or
+        uint16_t part = device.runMillis + gap;             // stopped total, again carrying
+        while (part >= 1000) {                              // whole seconds
+          part -= 1000;                                     //
+          device.runSeconds = device.runSeconds + 1;        //
+        }                                                   // of while-loop whole seconds
+        device.runMillis = part;                            //
+      } else {                                              //
+        uint16_t part = device.stopMillis + gap;            //
+        while (part >= 1000) {                              //
+          part -= 1000;                                     //
+          device.stopSeconds = device.stopSeconds + 1;      //
+        }                                                   // of while-loop whole seconds
+        device.stopMillis = part;                           //
+      }                                                     // of if-then-else running
+    }                                                       // of if-then not the first sentence
+    device.lastFrame = now ? now : 1;                       // 0 means no sentence yet
+    if (_refreshMillis && (int32_t)(now - device.nextRefresh) >= 0) {  // Settings are due
+      uint32_t next = device.nextRefresh + _refreshMillis;  // Keep to the schedule so that the
+      if ((int32_t)(now - next) >= 0) next = now + _refreshMillis;  // devices stay staggered
+      device.nextRefresh = next;                            // unless it fell behind, and
+      setMode(idx, MODE_SETTINGS);                          // ask for a settings sentence
+    }                                                       // of if-then settings refresh due
+    if (alarm != device.alarm) {                            // The alarm code changed, so
+      device.alarm = alarm;                                 // remember the new one and
+      queueEvent(idx, CUBIGEL_ALARM, alarm, now);           // tell the calling program
+    }                                                       // of if-then alarm code changed
+    if (device.historySize) {                               // Store sample if there is a history
+      uint8_t head = device.historyHead;                    // Entry to write
+      uint8_t next = head + 1 == device.historySize ? 0 : head + 1;  // Following entry
+      if (next == device.historyTail) {                     // Buffer is full, so count the
+        if (device.historyDropped != UINT16_MAX)            // lost sample
+          device.historyDropped = device.historyDropped + 1;  //
+      } else {                                              // otherwise store it
+        volatile CubigelSampleType &sample = device.history[head];
+        sample.time        = now;                           //
+        sample.RPM         = RPM;                           //
+        sample.mA          = cubigelmA(rawmA);              // Only converted for the history
+        sample.alarm       = alarm;                         //
+        device.historyHead = next;                          // and make it visible to the reader
+      }                                                     // of if-then-else buffer is full
+    }                                                       // of if-then history is enabled
+  } else if (status == CUBIGEL_PARSE_SETTINGS) {            // We have a complete 80 sentence
+    volatile CubigelSettingsType &setting = settings[idx];  // Settings are in cold storage
+    bool     changed = buffer[7] != setting.modeByte;       // Set if any setting differs
+    uint16_t value   = ((uint16_t)buffer[2] << 8) | buffer[3];  // Get minimum RPM
+    changed |= value != setting.minSpeed;                   //
+    setting.minSpeed = value;                               //
+    value            = ((uint16_t)buffer[4] << 8) | buffer[5];  // Get maximum RPM
+    changed |= value != setting.maxSpeed;                   //
+    setting.maxSpeed = value;                               //
+    for (uint8_t i = 0; i < 6; ++i) {                       // Store the raw voltages, they are
+      value = ((uint16_t)buffer[8 + i * 2] << 8) | buffer[9 + i * 2];  // only converted when read
+      changed |= value != setting.voltage[i];               //
+      setting.voltage[i] = value;                           //
+    }                                                       // of for-next each voltage
+    setting.modeByte = buffer[7];                           // Save bit register settings
+    if (changed && setting.received) {                      // Different from the last settings,
+      setting.changes = setting.changes + 1;                // so count the change and tell the
+      queueEvent(idx, CUBIGEL_SETTINGS_CHANGED, 0, millis());  // calling program
+    }                                                       // of if-then settings changed
+    if (setting.received != UINT8_MAX) setting.received = setting.received + 1;
+    setMode(idx, MODE_DEFAULT);                             // Reset device to default mode
+  } else if (status != CUBIGEL_PARSE_BUSY) {                // Otherwise it is an error
+    stats.commsErrors = stats.commsErrors + 1;              // Add to number of errors detected
+    volatile uint16_t &count = status == CUBIGEL_PARSE_BAD_START ? link.badStart
+                               : status == CUBIGEL_PARSE_BAD_TYPE ? link.badType
+                                                                  : link.badChecksum;
+    if (count != UINT16_MAX) count = count + 1;             // and to its type, saturating
+  }                                                         // of if-then-else sentence status
+  device.sequence = device.sequence + 1;                    // Even again, update is complete
+}  // of method storeSentence
 bool CubigelClass::readTiming(const uint8_t idx, uint32_t &onTime, uint32_t &offTime) {
   /*!
 @brief   called to return the given device's last state change from ON-OFF or OFF-ON
+@details The interrupt counts the changes and this function remembers the count it last saw, so
+         no interrupt guard is needed and a change arriving while this runs isn't lost. The times
+         are copied again if the interrupt updated them during the copy
 @param[in] idx Index to device array
-@param[out] onTime Timde device turned on
-@param[out] offTime Timde device turned off
-@return void
+@param[out] onTime Time device turned on
+@param[out] offTime Time device turned off
+@return true if the device turned on or off since the last call
 */
-  bool tempTimeChanged     = devices[idx].timeChanged;  // Store the current value to return
-  onTime                   = devices[idx].onTime;
-  offTime                  = devices[idx].offTime;
-  devices[idx].timeChanged = false;  // Reset the change flag if set
-  return (tempTimeChanged);
+  if (idx >= _deviceCount) return false;            // just return nothing if invalid
+  volatile CubigelDataType &device = devices[idx];  // Reference to device storage
+  uint8_t sequence, transitions;                    // Values before the copy
+  do {                                              // Repeat until the interrupt didn't change the
+    sequence    = device.sequence;                  // values during the copy
+    transitions = device.transitions;               //
+    onTime      = device.onTime;                    //
+    offTime     = device.offTime;                   //
+  } while ((sequence & 1) || sequence != device.sequence);
+  bool changed      = transitions != device.timingSeen;  // Changed since last call?
+  device.timingSeen = transitions;                       // Remember what has been seen
+  return changed;
 }  // of method ReadTiming
 void CubigelClass::requestSettings(const uint8_t idx) {
   /*!
@@ -369,8 +1538,10 @@ void CubigelClass::readSettings(const uint8_t idx, uint16_t &compMin, uint16_t &
                                 uint16_t &out12V, uint16_t &in12V, uint16_t &out24V,
                                 uint16_t &in24V, uint16_t &out42V, uint16_t &in42V, uint8_t &mode) {
   /*!
-    @brief     called to return the given device's settings. These are read once during class
-               instantiation and stored
+    @brief     called to return the given device's settings. These are read when the device is added
+               and whenever they are requested after that
+    @details   The raw values are copied again if the interrupt stored a new settings sentence
+               during the copy, and the voltages are converted to millivolts here
     @param[in] idx Index to device array
     @param[out] compMin
     @param[out] compMax
@@ -383,13 +1554,167 @@ void CubigelClass::readSettings(const uint8_t idx, uint16_t &compMin, uint16_t &
     @param[out] mode
     @return void
   */
-  compMin = devices[idx].minSpeed;  // Read values from structure into
-  compMax = devices[idx].maxSpeed;  // return variables
-  out12V  = devices[idx].cutOut12V;
-  in12V   = devices[idx].cutIn12V;
-  out24V  = devices[idx].cutOut24V;
-  in24V   = devices[idx].cutIn24V;
-  out42V  = devices[idx].cutOut42V;
-  in42V   = devices[idx].cutIn42V;
-  mode    = devices[idx].modeByte;
+  if (idx >= _deviceCount) return;                        // just return nothing if invalid
+  volatile CubigelSettingsType &setting = settings[idx];  // Reference to the settings
+  uint16_t voltage[6];                                    // Raw voltages
+  uint8_t  sequence;                                      // Sequence number before the copy
+  do {                                                    // Repeat until the interrupt didn't
+    sequence = devices[idx].sequence;                     // change the values during the copy
+    compMin  = setting.minSpeed;                          // Read values from structure into
+    compMax  = setting.maxSpeed;                          // return variables
+    mode     = setting.modeByte;                          //
+    for (uint8_t i = 0; i < 6; ++i) voltage[i] = setting.voltage[i];
+  } while ((sequence & 1) || sequence != devices[idx].sequence);
+  out12V = cubigelMillivolts(voltage[0]);               // Convert the voltages to millivolts
+  in12V  = cubigelMillivolts(voltage[1]);               //
+  out24V = cubigelMillivolts(voltage[2]);               //
+  in24V  = cubigelMillivolts(voltage[3]);               //
+  out42V = cubigelMillivolts(voltage[4]);               //
+  in42V  = cubigelMillivolts(voltage[5]);               //
 }  // of method ReadSettings
+void CubigelClass::setSettingsRefresh(const uint16_t seconds) {
+  /*!
+    @brief     request a settings sentence from each device at a fixed interval
+    @details   The first request for each device is spread evenly over the interval, so with two
+               devices and 600 seconds the first one is asked after 300 and the second after 600
+               seconds, and they then keep that distance. Call this after the devices are added
+    @param[in] seconds Interval between requests for a device, 0 turns the refresh off
+    @return    void
+  */
+  uint32_t interval = (uint32_t)seconds * 1000;        // Interval in milliseconds
+  uint32_t now      = millis();                        // Start of the schedule
+  interruptsOff();                                     // Disable interrupts
+  _refreshMillis = interval;                           // Store the interval and stagger the
+  for (uint8_t idx = 0; idx < _deviceCount; ++idx) {   // devices over it
+    devices[idx].nextRefresh = now + interval / _deviceCount * (idx + 1);
+  }                                                    // of for-next each device
+  interruptsOn();                                      // Enable interrupts
+}  // of method setSettingsRefresh()
+bool CubigelClass::settingsChanged(const uint8_t idx) {
+  /*!
+    @brief     return whether a settings sentence differed from the one before it since the last
+               call, e.g. because a DIP switch was changed
+    @param[in] idx Index to device array
+    @return    true if the settings changed since the last call
+  */
+  if (idx >= _deviceCount) return false;                  // just return nothing if invalid
+  volatile CubigelSettingsType &setting = settings[idx];  // Reference to the settings
+  uint8_t changes     = setting.changes;                  // Changes counted by the interrupt
+  bool    changed     = changes != setting.changesSeen;   // Any since the last call?
+  setting.changesSeen = changes;                          // Remember what has been seen
+  return changed;
+}  // of method settingsChanged()
+/***************************************************************************************************
+** The sentence types are defined in a small table rather than in the parser logic. Each entry    **
+** gives the type byte which follows the start byte, the total sentence length and the value used **
+** in place of the start byte when computing the even byte checksum. The last two bytes of each   **
+** sentence are the XOR of all the even and all the odd bytes before them.                        **
+***************************************************************************************************/
+/*! @brief Definition of one FDC1 sentence type */
+struct CubigelSentenceType {
+  uint8_t type;      ///< Sentence type byte
+  uint8_t length;    ///< Total sentence length including checksums
+  uint8_t evenSeed;  ///< Starting value for the even byte checksum
+  uint8_t status;    ///< Parser status returned for a valid sentence
+};  // of struct CubigelSentenceType
+static const CubigelSentenceType kSentenceTypes[] = {
+    {76, 8, CUBIGEL_START_BYTE, CUBIGEL_PARSE_VALUES},      // Speed and current sentence
+    {80, CUBIGEL_SENTENCE_MAX, 72, CUBIGEL_PARSE_SETTINGS}  // Settings sentence, uses 72 not 27
+};  ///< Table of sentence types
+const uint8_t CUBIGEL_SENTENCE_TYPES{sizeof(kSentenceTypes) / sizeof(kSentenceTypes[0])};
+static const CubigelSentenceType *findSentenceType(const uint8_t type) {
+  /*!
+    @brief     Look up a sentence type in the table
+    @param[in] type Sentence type byte
+    @return    Pointer to the table entry or nullptr if the type is unknown
+  */
+  for (uint8_t i = 0; i < CUBIGEL_SENTENCE_TYPES; ++i) {
+    if (kSentenceTypes[i].type == type) return &kSentenceTypes[i];
+  }  // of for-next each sentence type
+  return nullptr;
+}  // of function findSentenceType()
+uint8_t CubigelParser::parse(const uint8_t value) {
+  /*!
+    @brief     Process the next byte received from the device
+    @details   The caller must call resume() until pending() returns false before passing in the
+               next byte, otherwise the replayed bytes would be processed out of order. Only bytes
+               passed in here are counted, not the ones replayed
+    @param[in] value Byte received
+    @return    CubigelParseStatus for the byte
+  */
+  if (_bytes != UINT32_MAX) ++_bytes;  // Count the byte, stopping at the highest value
+  return step(value);
+}  // of method parse()
+uint8_t CubigelParser::resume() {
+  /*!
+    @brief   Process the next byte being replayed after a sentence failed its checksum
+    @return  CubigelParseStatus for the byte
+  */
+  return step(buffer[_replay++]);
+}  // of method resume()
+uint8_t CubigelParser::step(const uint8_t value) {
+  /*!
+    @brief     The parser state machine, called for each byte
+    @param[in] value Byte to process
+    @return    CubigelParseStatus for the byte
+  */
+  switch (_state) {
+    case WAIT_START:                                       // Waiting for a sentence to start
+      if (value != CUBIGEL_START_BYTE) return CUBIGEL_PARSE_BAD_START;
+      buffer[0] = value;                                   // Store the start byte
+      _index    = 1;                                       // and wait for the type
+      _state    = WAIT_TYPE;                               //
+      return CUBIGEL_PARSE_BUSY;
+    case WAIT_TYPE: {                                      // Start byte seen, next is the type
+      const CubigelSentenceType *sentence = findSentenceType(value);
+      if (sentence == nullptr) {                           // Unknown type, a repeated start byte
+        if (value != CUBIGEL_START_BYTE) _state = WAIT_START;  // is treated as the new start
+        return CUBIGEL_PARSE_BAD_TYPE;
+      }                                          // of if-then unknown sentence type
+      buffer[1]    = value;                      // Store the type
+      _index       = 2;                          // and set up for the data
+      _type        = sentence - kSentenceTypes;  // Remember the table entry
+      _checksum[0] = sentence->evenSeed;         // Checksums include the start and
+      _checksum[1] = value;                      // type bytes
+      _state       = DATA;                       //
+      return CUBIGEL_PARSE_BUSY;
+    }                                                       // of case WAIT_TYPE
+    default: {                                              // Reading sentence data
+      const uint8_t length = kSentenceTypes[_type].length;  // Length of this sentence type
+      buffer[_index]       = value;                         // Store the byte
+      if (_index < length - 2) {                            // Data byte, add it to the checksum
+        _checksum[_index & 1] ^= value;
+        ++_index;
+        return CUBIGEL_PARSE_BUSY;
+      }                                      // of if-then a data byte
+      if (value != _checksum[_index & 1]) {  // Checksum mismatch, which is checked
+        resynchronize(_index + 1);           // as soon as each checksum arrives
+        return CUBIGEL_PARSE_BAD_CHECKSUM;
+      }                                                  // of if-then bad checksum
+      if (++_index < length) return CUBIGEL_PARSE_BUSY;  // Wait for the odd checksum
+      _state = WAIT_START;                               // Sentence is complete and valid
+      return kSentenceTypes[_type].status;
+    }  // of default case
+  }    // of switch parser state
+}  // of method step()
+void CubigelParser::resynchronize(const uint8_t length) {
+  /*!
+    @brief     Called when a sentence fails a checksum. The bytes after the start are searched for a
+               start byte which is either the last byte read or followed by a valid type; if one is
+               found then the bytes from there on are set up to be replayed through the parser.
+               Any bytes which were still waiting to be replayed are kept behind these
+    @param[in] length Number of bytes of the failed sentence in the buffer
+  */
+  uint8_t remaining = _replayEnd - _replay;               // Replay bytes not yet processed
+  memmove(buffer + length, buffer + _replay, remaining);  // go after the failed sentence
+  _replayEnd = length + remaining;                        //
+  _replay    = length;                                    // Default is to skip the whole sentence
+  for (uint8_t i = 1; i < length; ++i) {                  // Search for a new sentence start
+    if (buffer[i] == CUBIGEL_START_BYTE &&
+        (i + 1 == _replayEnd || findSentenceType(buffer[i + 1]) != nullptr)) {
+      _replay = i;                                         // Replay from the start byte
+      break;
+    }                   // of if-then a possible start of a sentence
+  }                     // of for-next each byte of the failed sentence
+  _state = WAIT_START;  // Start looking for a new sentence
+}  // of method resynchronize()
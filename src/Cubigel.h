@@ -18,9 +18,182 @@ interrupt to read the data and to compile statistics until such time as the call
 to consume it. The Arduino SoftwareSerial library is used, but as it only supports a single port at
 a time it will not work if more than one device uses the library. This library supports the use of
 both hardware and software serial ports, and if more than one device is used then at most one port
-can use the SoftwareSerial library/class. The pointer to the appropriate class instance is passed in
-to this library during class instantiation and the constructor is overloaded to reflect the various
-options available.
+can use the SoftwareSerial library/class.
+
+The number of devices is set at compile time by declaring a "CubigelBank<N>" instance, which holds
+the storage for exactly N devices so that no memory is used for unused entries. Each serial port is
+then registered using "addDevice()", which returns the index used to refer to that device in all
+of the other calls. Devices are read through the common Arduino "Stream" interface, so the timer
+interrupt does the same work for hardware and software serial ports.
+
+More than one bank can be declared, e.g. "CubigelBank<1> Fridge;" in one module and
+"CubigelBank<2> Freezers;" in another, and each one owns its own group of compressors. Every bank
+with a device read by the timer is put on a linked list when that device is added, and the Timer0
+interrupt walks the list and reads each bank's devices in turn, so the time spent in the interrupt
+depends on the total number of devices and not on how they are split between banks. A bank which
+goes out of scope takes itself off the list. Only one SoftwareSerial port can be used in total.
+
+The storage for each device is split into three parts. "CubigelDataType" holds the fields used by
+the interrupt for every sentence (port, flags and running totals), "CubigelParser" the sentence
+being read, and "CubigelSettingsType" the settings which are only written when a type 80 sentence
+arrives. On an Atmel processor these take 170, 33 and 26 bytes, or 229 bytes per device in total;
+the value is available as CUBIGEL_DEVICE_BYTES and checked at compile time so that any growth is
+noticed.
+
+The running totals are kept in two "CubigelStatisticsType" blocks per device. The interrupt adds to
+the active block and increments a sequence number before and after each update. When readValues()
+resets the statistics it switches the interrupt over to the other block with a single byte write
+and then reads the old block at leisure, since nothing else writes to it any more. When the values
+are read without a reset the active block is copied and the copy repeated if the sequence number
+changed in the meantime. Neither case needs interrupts to be disabled, so the SoftwareSerial pin
+change interrupts are never held up while the calling program reads the statistics.
+
+Besides the totals, each block keeps the lowest and highest RPM and mA and the sums of the squares
+of their differences from a reference value for the readings taken while the compressor was running.
+The interrupt only does integer additions, comparisons and one 16x16 bit multiplication per value,
+and "readStatistics()" works out the averages and variances from the sums when called, so even a
+program which only reads the values every 10 minutes can tell a steady speed from one that swings up
+and down without any samples being stored. The reference starts as the first running reading, which
+may be a start-up spike. After 4, 8, 16 and every further power of two running readings up to
+CUBIGEL_REBASE_LIMIT (1024) the sums are moved to the average so far, which takes a few
+multiplications and a shift. Taking the squares relative to the average keeps them small enough for
+32 bit sums, which stop at their highest value rather than wrap; "readStatistics()" then sets
+"saturated" and returns a variance of UINT32_MAX. A current which is always 100mA away from its
+average fills the sum after about 43,000 readings or 6 hours, a speed 200 RPM away never does within
+the 65,535 readings of a block.
+
+Each type 76 sentence can optionally be stored as a "CubigelSampleType" (time, RPM, mA and alarm
+code) in a ring buffer per device, so that the compressor start-up ramp or current spikes can be
+seen rather than just the averages. The ring buffer array is supplied by the calling program using
+"setHistory()", so no memory is used unless the history is wanted, and "readHistory()" copies as
+many samples as are waiting into the caller's array in one call. The interrupt only ever writes the
+head index and the calling program the tail index, so neither side needs interrupts disabled. When
+the buffer is full new samples are discarded and counted.
+
+Every time a compressor turns on or off, and every time the alarm code it sends changes, the
+interrupt adds a "CubigelEventType" with the time to a small queue which belongs to the bank. The
+calling program registers functions with "setTransitionCallback()" and "setAlarmCallback()" and
+calls "dispatchEvents()" from "loop()", which takes the events off the queue and calls the
+functions outside of the interrupt, so nothing is lost between calls and "readTiming()" doesn't
+need to be polled. The queue holds 7 events by default, "CubigelBank<2, 16> Cubigel;" makes it
+larger; when it is full further events are discarded and counted.
+
+The interrupt also integrates the current over time for each type 76 sentence, multiplying the mA
+value by the milliseconds since the previous sentence, and adds the same time to the running or
+stopped total. The charge is kept as a remainder below one mAh plus a count of whole mAh and the
+times as milliseconds below one second plus whole seconds, so only 32 bit additions and comparisons
+are needed and the totals don't wrap for years. Gaps of more than CUBIGEL_MAX_FRAME_GAP between
+sentences, e.g. while a cable is unplugged, only count that long. "readEnergy()" returns the charge,
+the energy at the supply voltage set with "setSupplyVoltage()" (12V unless changed), the running
+and stopped times, duty cycle, number of starts and mean cycle length. The totals run from when the
+device was added, the difference between two calls gives the values for a period.
+
+The 7 byte mode commands sent to the FDC1, when a device is added, by "requestSettings()" and after
+each settings sentence, are not written straight away. The mode is stored in the device's transmit
+queue. A hardware port gets as many bytes as there is room for in its transmit buffer from the
+timer tick, poll() or onReceive(), so nothing waits for the port inside the interrupt or in
+"requestSettings()". A SoftwareSerial write keeps interrupts disabled for the 8ms that each byte
+takes at 1200 baud, so those ports, and any other port without a transmit buffer, are never written
+to from the interrupt. Their bytes are sent from the program instead, one per "poll()" call or the
+whole command by "readValues()", so a sketch using the timer interrupt and a SoftwareSerial port
+should also call "poll()" from "loop()" to get the mode commands sent promptly.
+
+The FDC1 sends the current as mA * 3.16 and the voltages as mV * 1.187. Rather than dividing each
+value in the interrupt, the raw current values are added up, compared and integrated as they are and
+only converted when they are read, and the voltages are only converted in "readSettings()". The
+conversions use "cubigelScale()", which replaces the division by a constant with a multiplication by
+a reciprocal worked out at compile time and a 16 bit shift. That estimate is at most one too small
+for any 16 bit value, and a single multiply and compare corrects it, so the results are identical to
+the division. The "extras/host/CubigelConversions.cpp" program checks this for all 65536 values.
+
+For gateways which read the statistics over a serial link, "packTelemetry()" writes a device's
+statistics as a fixed 41 byte binary record into a buffer supplied by the calling program, which is
+then sent with a single "Serial.write()" call instead of being formatted as text. The record starts
+with a sync byte, a format version and its length, followed by the device index, the time it was
+made, the milliseconds covered by the statistics, the reading counts, the average, lowest and
+highest RPM and mA, the comms errors and alarm codes, the duty cycle, number of starts and mean
+cycle length. Multi-byte values are little-endian and the last two bytes are a CRC-16/CCITT of the
+rest, so a receiver can find the start of the next record after a lost byte. "CubigelTelemetry.h" in
+the "extras/host" directory decodes the records on the receiving side.
+
+To find out why a compressor's sentences are rejected in the field, "setCapture()" turns on a raw
+capture into a ring buffer supplied by the calling program. Every byte read from any of the ports
+is then stored as a "CubigelCaptureType" with the time, the device index and the parser's verdict
+on that byte, so a rejected sentence shows up as the bytes leading up to a CUBIGEL_PARSE_BAD_xxx
+status. "readCapture()" copies the waiting entries out, e.g. to write them to an SD card or the USB
+port, and when the buffer is full further bytes are discarded and counted. Nothing is stored, and
+the only cost is one test per byte, while no capture buffer is set. The "CubigelReplay.cpp" program
+in "extras/host" feeds a capture back through the same parser on a desktop machine at the recorded
+times, so that a problem can be reproduced and decoder changes measured on real traffic.
+
+The "commsErrors" count in the statistics lumps all failures together and is reset with them, so
+each device also keeps link counters which are never reset by readValues() and stop at their
+highest value rather than wrapping: bytes read, sentences accepted, bytes discarded while looking
+for a start byte, unknown sentence types and checksum failures, plus a histogram of the time between
+type 76 sentences. "readLinkStats()" returns them as a "CubigelLinkType". A noisy cable mostly shows
+up as checksum failures with the sentences still arriving every 500ms, while bytes lost by a
+SoftwareSerial port whose pin change interrupt was held up also leave sentences 1000ms or more
+apart and bytes skipped before the next start byte. The parser counts the bytes itself and the
+device's count is updated with each sentence, so the per byte cost is one non-volatile increment.
+
+Each device also runs a small health check on the type 76 sentences as they arrive, so that a
+failing compressor shows up before the averages change enough to be noticed. The current drawn at a
+given speed is learned separately for 4 speed bands as a moving average, weighted towards the
+first sentences while there are fewer than CUBIGEL_HEALTH_LEARN of them, and a faster average of
+the difference from the learned value is kept. Readings which differ by more than a quarter are not
+added to the learned value, so a lasting change stays flagged rather than becoming the new normal.
+Runs shorter than CUBIGEL_FAILED_START_MS count as failed starts and runs shorter than
+CUBIGEL_SHORT_CYCLE_MS as short cycles. Each adds 1 to its score while a normal run halves it, so
+the flag is raised after CUBIGEL_HEALTH_REPEATS of them in a row. "readHealth()" returns all of
+this as one byte of CUBIGEL_HEALTH_xxx flags which are set now or have been set since the previous
+call, which is all a gateway needs to poll, and "readHealthReport()" the learned values and scores
+behind it. The state takes 18 bytes per device and never grows, and "resetHealth()" starts the
+learning again after a compressor has been serviced or replaced.
+
+Defining "CUBIGEL_PROFILE" as a compiler flag adds timing code which measures how long each timer
+tick and each processDevice() call takes and how long the library keeps interrupts disabled outside
+the tick, which decides whether a SoftwareSerial port can still receive every bit. "readProfile()"
+returns the shortest, longest and mean tick, the number of ticks which read or sent something and
+of those which had nothing to do, the longest single byte and the longest interrupts off window as
+a "CubigelProfileType". On an Arduino the times are in microseconds from micros(), which only
+changes every 4us on a 16MHz board, and in a host build in nanoseconds from the monotonic clock;
+CUBIGEL_PROFILE_NS gives the unit. The flag has to reach the compile of Cubigel.cpp, for example in
+the board's build flags, as a "#define" in a sketch doesn't; the class is the same either way and
+without the flag none of the timing code is compiled in and "readProfile()" returns all zeroes. The
+timings are shared by every bank, since one tick reads them all.
+
+The settings are requested when a device is added and, after "setSettingsRefresh()" has been
+called, again at that interval. The refresh times are spread evenly over the interval for the
+different devices, so that two compressors are never switched into settings mode at the same time.
+The settings are stored as the raw words sent by the FDC1 and only converted to millivolts when
+"readSettings()" is called. Each new settings sentence is compared with the stored one, and when a
+DIP switch or mode change shows up "settingsChanged()" returns true and a CUBIGEL_SETTINGS_CHANGED
+event is added to the event queue for the function registered with "setSettingsCallback()".
+
+Instead of the Timer0 interrupt the ports can be read by the calling program, by declaring the bank
+with "CubigelBank<N> Cubigel(CUBIGEL_POLLED);" and calling "poll()" from "loop()" or a scheduler.
+Each call processes every byte waiting in the receive buffers in one batch, so it needs to be called
+at least every 50 milliseconds or so to stop the 64 byte Arduino buffers from overflowing at 1200
+baud. No time is then spent in an interrupt when nothing arrives. Defining "CUBIGEL_NO_TIMER" as a
+compiler flag leaves the interrupt routine out of the library altogether, so that another library
+can use TIMER0_COMPA_vect, and this is done automatically on boards other than AVR ones since they
+don't have the Timer0 registers; in both cases every CubigelBank uses polled mode. On those boards
+interrupts are disabled with "noInterrupts()" rather than the AVR "cli()", and the
+"addDevice(SoftwareSerial *)" call is only there when the core ships a SoftwareSerial library (AVR
+and ESP8266), which sets "CUBIGEL_SOFTWARE_SERIAL". Other boards use their hardware ports.
+
+Hardware serial ports can also be read as soon as data arrives rather than by the timer or poll(),
+by adding them with "addDevice(&Serial1, CUBIGEL_EVENT);" and calling "onReceive()" for the device
+from the matching Arduino "serialEvent1()" function. The Arduino core runs these after each pass
+through "loop()" when the port has received something, so nothing at all is done while the
+compressor is quiet between sentences. The Timer0 interrupt is only enabled once a device which it
+reads has been added, so on a setup which only has event driven hardware ports the library costs no
+CPU time when idle. As with poll(), "loop()" must not take longer than about 50 milliseconds.
+
+The library can also be compiled on a desktop machine without the Arduino IDE, in which case the
+"CubigelHost.h" shim replaces the Arduino functions and the timer interrupt is not used; the host
+program calls "TimerISR()" itself. The "extras/host" directory contains a simulated compressor and a
+benchmark program which use this to measure the sentence decoding speed.
 
 Although programming for the Arduino and in c/c++ is new to me, I'm a professional programmer and
 have learned, over the years, that it is much easier to ignore superfluous comments than it is to
@@ -65,6 +238,27 @@ Written by Arnd <Arnd@Zanduino.Com> at https://www.github.com/SV-Zanshin
 
 Version | Date       | Developer  | Comments
 ------- | ---------- | ---------- | ---------------------------------------------------------------
+2.16.0  | 2026-10-16 | SV-Zanshin | Timer interrupt reads every bank, not just the last declared
+2.15.0  | 2026-10-16 | SV-Zanshin | Added on-device compressor health flags, readHealth()
+2.14.0  | 2026-10-16 | SV-Zanshin | Added CUBIGEL_PROFILE timer tick and interrupts off timing
+2.13.0  | 2026-10-16 | SV-Zanshin | Added per device link counters, gap histogram, readLinkStats()
+2.12.0  | 2026-10-16 | SV-Zanshin | Added setCapture() raw byte capture and readCapture()
+2.11.0  | 2026-10-16 | SV-Zanshin | Added packTelemetry() binary statistics records with CRC-16
+2.10.0  | 2026-10-16 | SV-Zanshin | Raw current totals and multiply-shift conversions, no division
+2.9.0   | 2026-10-16 | SV-Zanshin | Added periodic settings refresh, change detection, raw settings
+2.8.0   | 2026-10-16 | SV-Zanshin | Mode commands are queued and sent a few bytes at a time
+2.7.0   | 2026-10-16 | SV-Zanshin | Added charge, energy and duty cycle accounting with readEnergy()
+2.6.0   | 2026-10-16 | SV-Zanshin | Added on/off and alarm event queue, callbacks, fix readTiming()
+2.5.0   | 2026-10-16 | SV-Zanshin | Added event driven hardware ports, Timer0 only started if needed
+2.4.0   | 2026-10-16 | SV-Zanshin | Added polled mode and poll() as an alternative to Timer0
+2.3.0   | 2026-10-16 | SV-Zanshin | Added min/max/variance statistics and readStatistics()
+2.2.0   | 2026-10-16 | SV-Zanshin | Added optional per device history of type 76 samples
+2.1.0   | 2026-10-16 | SV-Zanshin | readValues() uses double buffered statistics, no cli()/sei()
+2.0.1   | 2026-10-16 | SV-Zanshin | Split device storage into hot and cold sections, tagged port
+2.0.0   | 2026-10-16 | SV-Zanshin | Replaced constructors with CubigelBank<N> and addDevice()
+1.0.7   | 2026-10-16 | SV-Zanshin | Drain up to a configurable number of bytes per device per tick
+1.0.6   | 2026-10-16 | SV-Zanshin | Replaced processDevice() state logic with a CubigelParser class
+1.0.5   | 2026-10-16 | SV-Zanshin | Added host build shim, simulated compressor, decoder benchmark
 1.0.4   | 2020-12-07 | SV-Zanshin | Converted to doxygen commenting
 1.0.3   | 2020-09-30 | SV-Zanshin | Issue #2 - convert sources to clang-format compatibility
 1.0.2   | 2017-08-21 | SV-Zanshin | Removed extraneous code, changed comments
@@ -75,72 +269,484 @@ Version | Date       | Developer  | Comments
 */
 // clang-format on
 
-#include "Arduino.h"                     // Arduino data type definitions
-#include "SoftwareSerial.h"              // Software serial port emulation
 #ifndef Cubigel_h                        // Guard code definition
   #define Cubigel_h                      ///< Define the name inside guard code
+  #if defined(ARDUINO)                   // When compiling in the Arduino IDE
+    #include "Arduino.h"                 // Arduino data type definitions
+    #if defined(__AVR__) || defined(ARDUINO_ARCH_ESP8266)
+      #define CUBIGEL_SOFTWARE_SERIAL    ///< The core ships the SoftwareSerial library
+    #endif
+    #if defined(CUBIGEL_SOFTWARE_SERIAL)
+      #include "SoftwareSerial.h"        // Software serial port emulation
+    #endif
+  #else                                  // otherwise this is a host build
+    #include "CubigelHost.h"             // Host shim for the Arduino functions
+    #define CUBIGEL_SOFTWARE_SERIAL      ///< The shim has a SoftwareSerial stand-in
+  #endif
+  #if defined(ARDUINO) && !defined(__AVR__) && !defined(CUBIGEL_NO_TIMER)
+    #define CUBIGEL_NO_TIMER             ///< Only AVR processors have Timer0, so poll() is used
+  #endif
+  #if defined(ARDUINO)
+const uint16_t CUBIGEL_PROFILE_NS{1000};  ///< Nanoseconds per profile time unit, from micros()
+  #else
+const uint16_t CUBIGEL_PROFILE_NS{1};     ///< Nanoseconds per profile time unit, host clock
+  #endif
 const uint16_t CUBIGEL_BAUD_RATE{1200};  ///< Cubigel has a fixed baud rate
-const uint8_t  CUBIGEL_MAX_DEVICES{2};   ///< Max number of devices supported
+const uint8_t  CUBIGEL_NO_DEVICE{255};   ///< Returned by addDevice() when the bank is full
 const uint8_t  MODE_DEFAULT{0};          ///< Default output mode
 const uint8_t  MODE_SETTINGS{1};         ///< Output settings mode
-/*! @brief  this structure contains all of the variables stored per Cubigel device */
+const uint8_t  CUBIGEL_TIMER{0};         ///< Read the ports from the Timer0 interrupt
+const uint8_t  CUBIGEL_POLLED{1};        ///< Read the ports when poll() is called
+const uint8_t  CUBIGEL_EVENT{2};         ///< Read a hardware port when onReceive() is called
+const uint8_t  CUBIGEL_BURST_BYTES{4};   ///< Default max bytes read per device per timer tick
+const uint8_t  CUBIGEL_TICK_BUDGET{8};   ///< Default max bytes read for all devices per tick
+const uint8_t  CUBIGEL_EVENT_QUEUE{8};   ///< Default event queue size, holds one event less
+const uint16_t CUBIGEL_MAX_FRAME_GAP{2000};  ///< Longest time counted between two sentences, ms
+const uint16_t CUBIGEL_12V{12000};       ///< Nominal supply voltage of the 12V band in mV
+const uint16_t CUBIGEL_24V{24000};       ///< Nominal supply voltage of the 24V band in mV
+const uint16_t CUBIGEL_42V{42000};       ///< Nominal supply voltage of the 42V band in mV
+const uint8_t  CUBIGEL_START_BYTE{27};   ///< First byte of every FDC1 sentence
+const uint8_t  CUBIGEL_SENTENCE_MAX{22}; ///< Longest FDC1 sentence (type 80)
+const uint8_t  CUBIGEL_COMMAND_BYTES{7}; ///< Length of the FDC1 mode command
+const uint8_t  CUBIGEL_NO_COMMAND{255};  ///< No mode command waiting in the transmit queue
+const uint16_t CUBIGEL_MA_SCALE{1000};   ///< mA = raw * CUBIGEL_MA_SCALE / CUBIGEL_MA_RAW
+const uint16_t CUBIGEL_MA_RAW{3160};     ///< Raw current units per CUBIGEL_MA_SCALE mA
+const uint16_t CUBIGEL_MV_SCALE{1000};   ///< mV = raw * CUBIGEL_MV_SCALE / CUBIGEL_MV_RAW
+const uint16_t CUBIGEL_MV_RAW{1187};     ///< Raw voltage units per CUBIGEL_MV_SCALE mV
+const uint32_t CUBIGEL_RAW_MS_PER_MAH{3600000UL * CUBIGEL_MA_RAW / CUBIGEL_MA_SCALE};  ///< 1 mAh
+static_assert(3600000UL * CUBIGEL_MA_RAW % CUBIGEL_MA_SCALE == 0, "1 mAh must be whole raw x ms");
+const uint8_t  CUBIGEL_TELEMETRY_SYNC{0xC6};    ///< First byte of a packTelemetry() record
+const uint8_t  CUBIGEL_TELEMETRY_VERSION{1};    ///< Format version of a packTelemetry() record
+const uint8_t  CUBIGEL_TELEMETRY_BYTES{41};     ///< Length of a packTelemetry() record
+const uint8_t  CUBIGEL_GAP_BUCKETS{6};          ///< Buckets in the sentence gap histogram
+const uint8_t  CUBIGEL_HEALTH_BANDS{4};         ///< Speed bands with their own learned current
+const uint8_t  CUBIGEL_HEALTH_LEARN{32};        ///< Readings before a band's current is used
+const uint16_t CUBIGEL_REBASE_LIMIT{1024};      ///< Squares last moved to the average at this count
+const uint16_t CUBIGEL_HEALTH_SETTLE_MS{5000};  ///< Current not checked this long after a start
+const uint16_t CUBIGEL_FAILED_START_MS{10000};  ///< Shorter runs count as failed starts
+const uint32_t CUBIGEL_SHORT_CYCLE_MS{180000};  ///< Shorter runs count as short cycles
+const uint8_t  CUBIGEL_HEALTH_REPEATS{3};       ///< Score at which a start or cycle flag is set
+const uint8_t  CUBIGEL_HEALTH_CURRENT{0x01};    ///< Health flag - current is a quarter off normal
+const uint8_t  CUBIGEL_HEALTH_STARTS{0x02};     ///< Health flag - repeated failed starts
+const uint8_t  CUBIGEL_HEALTH_CYCLING{0x04};    ///< Health flag - repeated short cycles
+const uint8_t  CUBIGEL_HEALTH_ALARM{0x08};      ///< Health flag - compressor sends an alarm code
+const uint8_t  CUBIGEL_PORT_SOFTWARE{0x01};     ///< Device flag - port is a SoftwareSerial
+const uint8_t  CUBIGEL_PORT_BUFFERED{0x02};     ///< Device flag - port has a transmit buffer
+const uint8_t  CUBIGEL_PORT_EVENT{0x04};        ///< Device flag - port is read by onReceive()
+/*! @brief Types of event put into the event queue */
+enum CubigelEventKind {
+  CUBIGEL_TURNED_ON,        ///< Compressor started running
+  CUBIGEL_TURNED_OFF,       ///< Compressor stopped
+  CUBIGEL_ALARM,            ///< Alarm code changed, 0 when the alarm has cleared
+  CUBIGEL_SETTINGS_CHANGED  ///< A settings sentence differed from the previous one
+};  // of enum CubigelEventKind
+/*! @brief Result of passing a byte to the CubigelParser */
+enum CubigelParseStatus {
+  CUBIGEL_PARSE_BUSY,          ///< Byte accepted, sentence not yet complete
+  CUBIGEL_PARSE_VALUES,        ///< Valid type 76 (speed and current) sentence complete
+  CUBIGEL_PARSE_SETTINGS,      ///< Valid type 80 (settings) sentence complete
+  CUBIGEL_PARSE_BAD_START,     ///< Byte discarded while waiting for a start byte
+  CUBIGEL_PARSE_BAD_TYPE,      ///< Unknown sentence type after a start byte
+  CUBIGEL_PARSE_BAD_CHECKSUM   ///< Complete sentence failed a checksum
+};  // of enum CubigelParseStatus
+
+constexpr uint16_t cubigelGcd(const uint16_t a, const uint16_t b) {
+  /*!
+    @brief     Greatest common divisor, used to reduce the conversion fractions at compile time
+    @param[in] a First value
+    @param[in] b Second value
+    @return    Greatest common divisor of a and b
+  */
+  return b ? cubigelGcd(b, a % b) : a;
+}  // of function cubigelGcd()
+template <uint16_t SCALE, uint16_t RAW>
+inline uint16_t cubigelScale(const uint16_t raw) {
+  /*!
+    @brief     Return raw * SCALE / RAW, rounded down, without dividing
+    @details   The fraction is reduced to num/den and multiplied by floor(65536 * num / den), which
+               fits into 16 bits since num is less than den. Taking the top 16 bits of the 32 bit
+               product gives a result which is either exact or one too small for any 16 bit input,
+               since the reciprocal is less than one unit low and the input below 65536. The
+               remainder raw * num - result * den shows which, so one compare corrects it and the
+               result is the same as the division for every input
+    @param[in] raw Value to convert
+    @return    Converted value
+  */
+  static_assert(SCALE < RAW, "Only conversions which make the value smaller are supported");
+  constexpr uint16_t num        = SCALE / cubigelGcd(SCALE, RAW);     // Reduced fraction
+  constexpr uint16_t den        = RAW / cubigelGcd(SCALE, RAW);       //
+  constexpr uint16_t multiplier = ((uint32_t)num << 16) / den;        // Reciprocal, rounded down
+  uint16_t result = ((uint32_t)raw * multiplier) >> 16;               // Estimate, at most 1 low
+  if ((uint32_t)raw * num - (uint32_t)result * den >= den) ++result;  // Correct it if needed
+  return result;
+}  // of function cubigelScale()
+inline uint16_t cubigelmA(const uint16_t raw) {
+  /*!
+    @brief     Convert a raw FDC1 current value to milliamps
+    @param[in] raw Current as sent in a type 76 sentence
+    @return    Current in mA, the same as raw * 1000 / 3160
+  */
+  return cubigelScale<CUBIGEL_MA_SCALE, CUBIGEL_MA_RAW>(raw);
+}  // of function cubigelmA()
+inline uint16_t cubigelMillivolts(const uint16_t raw) {
+  /*!
+    @brief     Convert a raw FDC1 voltage value to millivolts
+    @param[in] raw Voltage as sent in a type 80 sentence
+    @return    Voltage in mV, the same as raw * 1000 / 1187
+  */
+  return cubigelScale<CUBIGEL_MV_SCALE, CUBIGEL_MV_RAW>(raw);
+}  // of function cubigelMillivolts()
+
+inline uint16_t cubigelCrc16(uint16_t crc, const uint8_t value) {
+  /*!
+    @brief     Add a byte to a CRC-16/CCITT (polynomial 0x1021, start with 0xFFFF) checksum
+    @details   Worked out a bit at a time rather than with a 512 byte table, which would take more
+               flash than the rest of the record code on an Atmel processor
+    @param[in] crc   Checksum of the bytes so far, 0xFFFF for the first byte
+    @param[in] value Byte to add
+    @return    Checksum including the byte
+  */
+  crc ^= (uint16_t)value << 8;                                    // Add the byte to the top
+  for (uint8_t bit = 0; bit < 8; ++bit) {                         // then divide one bit at
+    crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);  // a time
+  }  // of for-next each bit
+  return crc;
+}  // of function cubigelCrc16()
+
+class CubigelParser {
+  /*!
+   * @class CubigelParser
+   * @brief Incremental FDC1 sentence parser
+   * @details Bytes are passed in one at a time using parse(). The sentence type is looked up in a
+   *          small table giving the sentence length and checksum seed, and both XOR checksums are
+   *          updated as each byte arrives so that the end of a sentence needs no pass over it.
+   *          When a sentence fails its checksum the bytes already read are searched for a later
+   *          start byte, and if one is found those bytes are fed through the parser again using
+   *          resume() so that a sentence which started inside a truncated one is not lost. One
+   *          received byte can so lead to up to CUBIGEL_SENTENCE_MAX - 1 replayed bytes, which
+   *          the caller can spread over several calls since they stay pending until resumed.
+   */
+ public:
+  uint8_t parse(const uint8_t value);                  // Process the next received byte
+  uint8_t resume();                                    // Process the next byte being replayed
+  bool    pending() const { return _replay < _replayEnd; }  ///< Replay bytes waiting for resume()
+  uint32_t bytes() const { return _bytes; }            ///< Bytes passed to parse(), saturating
+  void    resetBytes() { _bytes = 0; }                 ///< Start counting the bytes again
+  uint8_t buffer[CUBIGEL_SENTENCE_MAX];                ///< Sentence bytes, valid after a sentence
+ private:
+  /*! @brief States of the parser */
+  enum State { WAIT_START, WAIT_TYPE, DATA };
+  uint8_t step(const uint8_t value);                   // Run the state machine for one byte
+  void    resynchronize(const uint8_t length);         // Look for a start byte after a failure
+  uint8_t _state       = WAIT_START;                   // Current parser state
+  uint8_t _index       = 0;                            // Next position in buffer
+  uint8_t _type        = 0;                            // Sentence type table entry being read
+  uint8_t _checksum[2] = {0, 0};                       // Running even and odd byte checksums
+  uint8_t _replay      = 0;                            // Next buffer byte to replay
+  uint8_t _replayEnd   = 0;                            // End of bytes to replay
+  uint32_t _bytes      = 0;                            // Bytes received, stops at UINT32_MAX
+};  // of class CubigelParser
+
+/*! @brief  this structure contains the statistics collected between calls to readValues() */
+typedef struct {
+  uint16_t readings;      ///< Number of readings stored
+  uint16_t running;       ///< Number of readings with the compressor running
+  uint32_t totalRPM;      ///< Sum of all RPM values
+  uint32_t totalRawmA;    ///< Sum of all raw current values
+  uint32_t squaresRPM;    ///< Sum of the squared differences from refRPM, stops at UINT32_MAX
+  uint32_t squaresRawmA;  ///< Sum of the squared differences from refRawmA, stops at UINT32_MAX
+  uint16_t refRPM;        ///< RPM the squares are taken relative to, see rebaseSquares()
+  uint16_t refRawmA;      ///< Raw current the squares are taken relative to
+  uint16_t minRPM;        ///< Lowest RPM while running
+  uint16_t maxRPM;        ///< Highest RPM while running
+  uint16_t minRawmA;      ///< Lowest raw current while running
+  uint16_t maxRawmA;      ///< Highest raw current while running
+  uint8_t  errorStatus;   ///< OR'd values of all errors found
+  uint16_t commsErrors;   ///< Number of communications errors
+} CubigelStatisticsType;  ///< of CubigelStatisticsType declaration
+/*! @brief  this structure is returned by readStatistics(), values are for readings while running */
+typedef struct {
+  uint16_t readings;     ///< Number of type 76 sentences read
+  uint16_t running;      ///< Number of those with the compressor running
+  uint16_t RPM;          ///< Average RPM
+  uint16_t minRPM;       ///< Lowest RPM
+  uint16_t maxRPM;       ///< Highest RPM
+  uint32_t varianceRPM;  ///< Variance of the RPM values, UINT32_MAX if too large to sum
+  uint16_t mA;           ///< Average Milliamps
+  uint16_t minmA;        ///< Lowest Milliamps
+  uint16_t maxmA;        ///< Highest Milliamps
+  uint32_t variancemA;   ///< Variance of the Milliamps values, UINT32_MAX if too large to sum
+  uint8_t  errorStatus;  ///< OR'd Cubigel alarm codes
+  uint16_t commsErrors;  ///< Number of communications errors
+  bool     saturated;    ///< A sum of squares filled up, that variance is UINT32_MAX
+} CubigelSummaryType;    ///< of CubigelSummaryType declaration
+/*! @brief  this structure is returned by readEnergy(), totals since the device was added */
+typedef struct {
+  uint32_t mAh;            ///< Charge used in milliamp hours
+  uint32_t mWh;            ///< Energy used in milliwatt hours at the supply voltage
+  uint32_t runSeconds;     ///< Time the compressor was running
+  uint32_t stopSeconds;    ///< Time the compressor was stopped
+  uint16_t dutyCycle;      ///< Running time in 1/100ths of a percent, 0 to 10000
+  uint16_t cycles;         ///< Number of times the compressor started
+  uint32_t cycleSeconds;   ///< Mean length of a start to start cycle
+  uint16_t supplyVoltage;  ///< Supply voltage used for mWh, in millivolts
+} CubigelEnergyType;       ///< of CubigelEnergyType declaration
+/*! @brief  this structure contains one decoded type 76 sentence for the history ring buffer */
 typedef struct {
-  HardwareSerial *serialHW;     ///< Pointer to HardwareSerial
-  SoftwareSerial *serialSW;     ///< Pointer to SoftwareSerial
-  uint8_t         buffer[22];   ///< Data buffer for device
-  uint8_t         index;        ///< Current index into data buffer
-  uint16_t        readings;     ///< Number of readings stored
-  uint32_t        totalRPM;     ///< Sum of all RPM values
-  uint32_t        totalmA;      ///< Sum of all Milliamps values
-  uint8_t         errorStatus;  ///< OR'd values of all errors found
-  uint16_t        commsErrors;  ///< Number of communications errors
-  uint16_t        minSpeed;     ///< Minimum speed setting
-  uint16_t        maxSpeed;     ///< Maximum speed setting
-  uint16_t        cutOut12V;    ///< 12V Cut out voltage
-  uint16_t        cutIn12V;     ///< 12V Cut in  voltage
-  uint16_t        cutOut24V;    ///< 24V Cut out voltage
-  uint16_t        cutIn24V;     ///< 24V Cut in  voltage
-  uint16_t        cutOut42V;    ///< 42V Cut out voltage
-  uint16_t        cutIn42V;     ///< 42V Cut in  voltage
-  uint8_t         modeByte;     ///< Mode setting switches
-  bool            timeChanged;  ///< Set to true when turned ON/OFF
-  uint32_t        onTime;       ///< Last millis() for an ON event
-  uint32_t        offTime;      ///< Last millis() for an OFF event
-} CubigelDataType;              ///< of CubigelDataType declaration
+  uint32_t time;      ///< millis() value when the sentence was decoded
+  uint16_t RPM;       ///< Compressor speed, 0 when the compressor is off
+  uint16_t mA;        ///< Current consumption in milliamps
+  uint8_t  alarm;     ///< Alarm code sent while the compressor is off
+} CubigelSampleType;  ///< of CubigelSampleType declaration
+/*! @brief  this structure contains one entry of the event queue */
+typedef struct {
+  uint32_t time;     ///< millis() value when the sentence showing the change was decoded
+  uint8_t  device;   ///< Index of the device
+  uint8_t  kind;     ///< CubigelEventKind value
+  uint8_t  alarm;    ///< New alarm code for CUBIGEL_ALARM events, otherwise 0
+} CubigelEventType;  ///< of CubigelEventType declaration
+/*! @brief  this structure contains one byte of the raw capture set with setCapture() */
+typedef struct {
+  uint32_t time;    ///< millis() value when the byte was read
+  uint8_t  device;  ///< Index of the device
+  uint8_t  value;   ///< Byte read from the port
+  uint8_t  status;  ///< CubigelParseStatus the parser returned for the byte
+} CubigelCaptureType;  ///< of CubigelCaptureType declaration
+typedef void (*CubigelEventCallback)(const CubigelEventType &event);  ///< Event handler function
+/*! @brief  this structure is returned by readProfile() when CUBIGEL_PROFILE is defined, the times
+            are in units of CUBIGEL_PROFILE_NS nanoseconds */
+typedef struct {
+  uint32_t busyTicks;    ///< Timer ticks which read or sent at least one byte
+  uint32_t idleTicks;    ///< Timer ticks with nothing to do
+  uint32_t minTime;      ///< Shortest timer tick
+  uint32_t maxTime;      ///< Longest timer tick
+  uint32_t meanTime;     ///< Mean length of all timer ticks
+  uint32_t maxByteTime;  ///< Longest processDevice() call, one byte and any sentence it completed
+  uint32_t maxOffTime;   ///< Longest time interrupts were disabled outside the timer tick
+} CubigelProfileType;    ///< of CubigelProfileType declaration
+/*! @brief  this structure contains the link counters returned by readLinkStats(), none of which
+            wrap around. The gap histogram buckets are for up to 450, 550, 1050, 1550 and 2050ms
+            and longer, i.e. early, on time and 1, 2, 3 or more sentences missing */
+typedef struct {
+  uint32_t bytes;                      ///< Bytes read, up to the last sentence or rejected byte
+  uint32_t frames;                     ///< Valid type 76 and type 80 sentences
+  uint16_t badStart;                   ///< Bytes discarded while waiting for a start byte
+  uint16_t badType;                    ///< Unknown sentence types after a start byte
+  uint16_t badChecksum;                ///< Sentences failing a checksum
+  uint16_t gaps[CUBIGEL_GAP_BUCKETS];  ///< Type 76 sentences by time since the previous one
+} CubigelLinkType;                     ///< of CubigelLinkType declaration
+/*! @brief  this structure contains the per device health check state, in raw current units */
+typedef struct {
+  uint16_t baseline[CUBIGEL_HEALTH_BANDS];  ///< Learned current per speed band
+  uint8_t  learned[CUBIGEL_HEALTH_BANDS];   ///< Readings in each band, stops at HEALTH_LEARN
+  int16_t  deviation;                       ///< Fast average of the difference from the baseline
+  uint8_t  startScore;                      ///< Failed start score
+  uint8_t  cycleScore;                      ///< Short cycle score
+  uint8_t  flags;                           ///< CUBIGEL_HEALTH_xxx conditions now
+  uint8_t  seen;                            ///< Conditions seen since readHealth() reset them
+} CubigelHealthType;                        ///< of CubigelHealthType declaration
+/*! @brief  this structure is returned by readHealthReport() */
+typedef struct {
+  uint8_t  flags;                             ///< CUBIGEL_HEALTH_xxx conditions now
+  uint8_t  seen;                              ///< Conditions seen since readHealth() reset them
+  uint16_t baselinemA[CUBIGEL_HEALTH_BANDS];  ///< Learned current per band, 0 while learning
+  int16_t  deviationmA;                       ///< Recent difference from the learned current
+  uint8_t  startScore;                        ///< Failed start score
+  uint8_t  cycleScore;                        ///< Short cycle score
+} CubigelHealthReportType;                    ///< of CubigelHealthReportType declaration
+/*! @brief  this structure contains the per device variables used by the interrupt for each sentence
+ */
+typedef struct {
+  Stream *                    port;            ///< Pointer to the hardware or software port
+  uint8_t                     flags;           ///< CUBIGEL_PORT_xxx bits
+  uint8_t                     active;          ///< Statistics block the interrupt is adding to
+  uint8_t                     sequence;        ///< Odd while the interrupt updates the device
+  CubigelStatisticsType       stats[2];        ///< Statistics, double buffered
+  uint32_t                    onTime;          ///< Last millis() for an ON event
+  uint32_t                    offTime;         ///< Last millis() for an OFF event
+  uint8_t                     transitions;     ///< ON/OFF changes, only set by the interrupt
+  uint8_t                     timingSeen;      ///< Value seen by readTiming(), only set by it
+  uint8_t                     alarm;           ///< Alarm code in the last type 76 sentence
+  uint8_t                     txMode;          ///< Mode byte of the command being sent
+  uint8_t                     txIndex;         ///< Next command byte sent, 7 when idle
+  uint8_t                     txNext;          ///< Mode byte of the next command or NO_COMMAND
+  uint32_t                    nextRefresh;     ///< millis() when the settings are next requested
+  uint32_t                    lastFrame;       ///< millis() of the last type 76 sentence, 0 none
+  uint32_t                    chargePart;      ///< Raw current x ms not yet a whole mAh
+  uint32_t                    chargemAh;       ///< Whole mAh used
+  uint32_t                    runSeconds;      ///< Whole seconds running
+  uint32_t                    stopSeconds;     ///< Whole seconds stopped
+  uint16_t                    runMillis;       ///< Milliseconds running not yet a whole second
+  uint16_t                    stopMillis;      ///< Milliseconds stopped not yet a whole second
+  uint16_t                    cycles;          ///< Number of compressor starts
+  volatile CubigelSampleType *history;         ///< Caller supplied history ring buffer or nullptr
+  uint8_t                     historySize;     ///< Number of entries in the history ring buffer
+  uint8_t                     historyHead;     ///< Next entry written, only set by the interrupt
+  uint8_t                     historyTail;     ///< Next entry read, only set by readHistory()
+  uint16_t                    historyDropped;  ///< Samples discarded because the buffer was full
+  CubigelLinkType             link;            ///< Link counters, never reset by readValues()
+  CubigelHealthType           health;          ///< Health check state
+} CubigelDataType;                             ///< of CubigelDataType declaration
+/*! @brief  this structure contains the per device settings, only written for type 80 sentences */
+typedef struct {
+  uint16_t minSpeed;       ///< Minimum speed setting
+  uint16_t maxSpeed;       ///< Maximum speed setting
+  uint16_t voltage[6];     ///< Raw 12V, 24V and 42V cut out and cut in voltages
+  uint8_t  modeByte;       ///< Mode setting switches
+  uint8_t  received;       ///< Settings sentences received, stops at 255
+  uint8_t  changes;        ///< Settings changes seen, only set by the interrupt
+  uint8_t  changesSeen;    ///< Value seen by settingsChanged(), only set by it
+  uint16_t supplyVoltage;  ///< Supply voltage in mV for readEnergy(), 0 means CUBIGEL_12V
+  uint32_t resetTime;      ///< millis() when the statistics were last reset
+} CubigelSettingsType;     ///< of CubigelSettingsType declaration
+const uint16_t CUBIGEL_DEVICE_BYTES{sizeof(CubigelDataType) + sizeof(CubigelParser) +
+                                    sizeof(CubigelSettingsType)};  ///< Memory used per device
+  #if defined(__AVR__)
+static_assert(CUBIGEL_DEVICE_BYTES == 229, "Per device memory changed, update the documentation");
+  #endif
 
 class CubigelClass {
   /*!
    * @class CubigelClass
    * @brief Main CubigelClass class for the Cubigel Compressor
+   * @details This class does all of the work but doesn't contain the device storage, it is not
+   *          instantiated directly. Declare a CubigelBank<N> instead, which supplies the storage
+   *          for N devices
    */
  public:                                                           // Publicly visible class members
-  CubigelClass(SoftwareSerial *serial1);                           // 1 Software device
-  CubigelClass(HardwareSerial *serial1);                           // 1 Hardware device
-  CubigelClass(HardwareSerial *serial1, SoftwareSerial *serial2);  // 2 devices - HW then SW
-  CubigelClass(SoftwareSerial *serial1, HardwareSerial *serial2);  // 2 devices - SW then HW
-  CubigelClass(HardwareSerial *serial1, HardwareSerial *serial2);  // 2 devices - HW and HW
+  uint8_t     addDevice(HardwareSerial *serial,
+                        const uint8_t   readMode = CUBIGEL_TIMER);  // Add a hardware serial device
+  #if defined(CUBIGEL_SOFTWARE_SERIAL)
+  uint8_t     addDevice(SoftwareSerial *serial);                   // Add a software serial device
+  #endif
+  uint8_t     addDevice(Stream *serial);                           // Add an already started port
+  uint8_t     deviceCount() const { return _deviceCount; }         ///< Number of devices added
   uint16_t    readValues(const uint8_t idx, uint16_t &RPM, uint16_t &mA,  // Just return RPM and mA
                          const bool resetReadings = true);
   uint16_t    readValues(const uint8_t idx, uint16_t &RPM,
                          uint16_t & mA,  // return number of readings and
                          uint16_t & commsErrors,
-                         uint16_t   errorStatus,  // update parameters with values
+                         uint16_t & errorStatus,   // update parameters with values
                          const bool resetReadings = true);
   void        readSettings(const uint8_t idx,
                            uint16_t &    compMin,  // Return the settings values
                            uint16_t &compMax, uint16_t &out12V, uint16_t &in12V, uint16_t &out24V,
                            uint16_t &in24V, uint16_t &out42V, uint16_t &in42V, uint8_t &mode);
   void        requestSettings(const uint8_t idx);  // Request a settings measurement
+  void        setSettingsRefresh(const uint16_t seconds);  // Request settings periodically
+  bool        settingsChanged(const uint8_t idx);  // Settings changed since the last call
+  void        setSettingsCallback(CubigelEventCallback callback);  // Called for changed settings
   bool        readTiming(const uint8_t idx, uint32_t &onTime, uint32_t &offTime);  //  changes
+  void        setBurst(const uint8_t deviceBytes, const uint8_t tickBytes);  // Set read limits
+  bool        setHistory(const uint8_t idx, CubigelSampleType *buffer,
+                         const uint8_t size);  // Set history ring buffer
+  uint8_t     readHistory(const uint8_t idx, CubigelSampleType *samples,
+                          const uint8_t maxSamples);  // Copy out waiting samples
+  uint16_t    readHistoryDropped(const uint8_t idx,
+                                 const bool    reset = false);  // Samples lost to a full buffer
+  CubigelSummaryType readStatistics(const uint8_t idx,
+                                    const bool    reset = true);  // Averages, min/max, variance
+  uint16_t    readBudgetHits(const bool reset = true);  // Ticks that left bytes unread
+  uint16_t    poll();                                   // Process all waiting bytes
+  uint16_t    onReceive(const uint8_t idx);             // Process an event driven device
+  bool        polled() const { return _polled; }        ///< true when poll() reads the ports
+  void        setTransitionCallback(CubigelEventCallback callback);  // Called for ON/OFF events
+  void        setAlarmCallback(CubigelEventCallback callback);       // Called for alarm events
+  bool        readEvent(CubigelEventType &event);         // Take the oldest event off the queue
+  uint8_t     dispatchEvents();                           // Call the callbacks for each event
+  uint16_t    readEventsDropped(const bool reset = false);  // Events lost to a full queue
+  bool        setSupplyVoltage(const uint8_t idx, const uint16_t millivolts);  // For readEnergy()
+  CubigelEnergyType readEnergy(const uint8_t idx);      // Charge, energy and duty cycle totals
+  uint8_t     packTelemetry(const uint8_t idx, uint8_t *buffer, const uint8_t size,
+                            const bool reset = true);  // Binary statistics record
+  void        setCapture(CubigelCaptureType *buffer, const uint8_t size);  // Raw byte capture
+  uint8_t     readCapture(CubigelCaptureType *entries,
+                          const uint8_t maxEntries);         // Copy out waiting capture entries
+  uint16_t    readCaptureDropped(const bool reset = false);  // Bytes lost to a full buffer
+  CubigelLinkType readLinkStats(const uint8_t idx,
+                                const bool    reset = false);  // Link counters and gap histogram
+  uint8_t     readHealth(const uint8_t idx, const bool reset = true);  // Health flags
+  CubigelHealthReportType readHealthReport(const uint8_t idx);  // Health check details
+  void        resetHealth(const uint8_t idx);                    // Learn the current again
+  static CubigelProfileType readProfile(const bool reset = true);  // Tick and interrupt timings
   static void TimerISR();                                 // Interim ISR calls real handler
- private:                                                 // Declare private class members
-  void setMode(const uint8_t idx, const uint8_t mode);    // Set Cubigel FDC1 mode
-  void StartTimer() const;                                // set the interrupt vector
-  void processDevice(const uint8_t deviceNumber);         // read and store data for a device
-  void TimerHandler();                                    // Called every millisecond for fade
-  static CubigelClass *    ClassPtr;                      // store pointer to class itself
-  bool                     _freezerPresent = false;       // Switch denoting if a freezer set
-  uint8_t                  _deviceCount    = 0;           // Number of devices instantiated
-  volatile CubigelDataType devices[CUBIGEL_MAX_DEVICES];  // Declare storage for max devices
+ protected:                                               // Only used by CubigelBank
+  CubigelClass(volatile CubigelDataType *deviceStorage, CubigelParser *parserStorage,
+               volatile CubigelSettingsType *settingsStorage, const uint8_t capacity,
+               volatile CubigelEventType *eventStorage, const uint8_t eventSize,
+               const uint8_t readMode);                         // Constructor with device storage
+  ~CubigelClass();                                              // Leave the timer list
+ private:                                                       // Declare private class members
+  void setMode(const uint8_t idx, const uint8_t mode);          // Set Cubigel FDC1 mode
+  void StartTimer() const;                                      // set the interrupt vector
+  uint8_t processDevice(const uint8_t deviceNumber,
+                        const uint8_t limit = UINT8_MAX);       // read and store data for a device
+  void storeSentence(const uint8_t idx, const uint8_t status);  // store a parsed sentence
+  bool TimerHandler();                                          // Called every millisecond for fade
+  void transmit(const uint8_t idx, const uint8_t limit = 1);    // Send waiting command bytes
+  bool snapshotStatistics(const uint8_t idx, CubigelStatisticsType &stats,
+                          const bool reset);               // Copy a device's statistics
+  uint8_t addDevice(Stream *serial, const uint8_t flags);  // Add a device with its port flags
+  void queueEvent(const uint8_t idx, const uint8_t kind, const uint8_t alarm,
+                  const uint32_t time);                   // Add an event to the queue
+  void captureByte(const uint8_t idx, const uint8_t value,
+                   const uint8_t status);                 // Add a byte to the capture
+  void checkHealth(const uint8_t idx, const uint16_t RPM, const uint16_t rawmA,
+                   const uint8_t alarm, const uint32_t runTime,
+                   const uint32_t now);                        // Health check of one sentence
+  void interruptsOff();                                        // cli(), timed when profiling
+  void interruptsOn();                                         // Restore SREG, timed if profiling
+  static CubigelClass *volatile _firstTimed;                   // First instance read by the timer
+  CubigelClass *volatile   _nextTimed = nullptr;               // Next instance read by the timer
+  uint8_t                  _deviceCount = 0;                   // Number of devices added
+  uint8_t                  _capacity;                          // Number of devices with storage
+  bool                     _polled;                            // Ports are read by poll()
+  bool                     _timed = false;                     // On the list read by the timer
+  uint8_t                  _burstBytes = CUBIGEL_BURST_BYTES;  // Max bytes per device per tick
+  uint8_t                  _tickBudget = CUBIGEL_TICK_BUDGET;  // Max bytes per tick
+  uint8_t                  _nextDevice = 0;                    // Device to read first next tick
+  volatile uint16_t        _budgetHits = 0;                    // Ticks which hit a limit
+  uint8_t                  _eventSize;                         // Entries in the event queue
+  volatile uint8_t         _eventHead    = 0;                  // Next event written
+  volatile uint8_t         _eventTail    = 0;                  // Next event read
+  volatile uint16_t        _eventsDropped = 0;                 // Events lost to a full queue
+  CubigelEventCallback     _transitionCallback = nullptr;      // Called for ON/OFF events
+  CubigelEventCallback     _alarmCallback      = nullptr;      // Called for alarm events
+  CubigelEventCallback     _settingsCallback   = nullptr;      // Called for changed settings
+  uint32_t                 _refreshMillis      = 0;            // Settings refresh, 0 for none
+  volatile CubigelCaptureType *_capture        = nullptr;      // Raw capture ring buffer
+  uint8_t                  _captureSize        = 0;            // Entries, 0 when not capturing
+  volatile uint8_t         _captureHead        = 0;            // Next entry written
+  volatile uint8_t         _captureTail        = 0;            // Next entry read
+  volatile uint16_t        _captureDropped     = 0;            // Bytes lost to a full buffer
+  uint8_t                  _interruptState     = 0;            // SREG saved by interruptsOff()
+  volatile CubigelEventType *   events;                        // Event queue storage
+  volatile CubigelDataType *    devices;                       // Hot storage for each device
+  CubigelParser *               parsers;                       // Sentence parser for each device
+  volatile CubigelSettingsType *settings;                      // Cold settings for each device
 };  // of class header definition for CubigelClass
+
+template <uint8_t DEVICES, uint8_t EVENTS = CUBIGEL_EVENT_QUEUE>
+class CubigelBank : public CubigelClass {
+  /*!
+   * @class CubigelBank
+   * @brief CubigelClass with storage for DEVICES compressors
+   * @details The device table is sized at compile time, e.g. "CubigelBank<2> Cubigel;" declares
+   *          storage for a fridge and a freezer. All of the code is in CubigelClass, so different
+   *          sizes don't duplicate any program code. "CubigelBank<2> Cubigel(CUBIGEL_POLLED);"
+   *          leaves Timer0 alone and reads the ports when poll() is called. The optional EVENTS
+   *          sets the size of the event queue, which holds up to EVENTS - 1 events. Several banks
+   *          can be declared and the timer interrupt reads all of them
+   */
+  static_assert(EVENTS >= 2, "The event queue needs at least 2 entries");
+ public:
+  CubigelBank(const uint8_t readMode = CUBIGEL_TIMER)
+      : CubigelClass(_deviceStorage, _parserStorage, _settingsStorage, DEVICES, _eventStorage,
+                     EVENTS, readMode) {}
+ private:
+  volatile CubigelDataType     _deviceStorage[DEVICES]   = {};  // Hot storage for each device
+  CubigelParser                _parserStorage[DEVICES];         // Sentence parser for each device
+  volatile CubigelSettingsType _settingsStorage[DEVICES] = {};  // Settings for each device
+  volatile CubigelEventType    _eventStorage[EVENTS];           // Event queue
+};  // of class header definition for CubigelBank
 #endif
@@ -0,0 +1,208 @@
+// clang-format off
+/*! @file CubigelHost.h
+
+@brief Host-side (Linux/desktop) shim for the Arduino functions used by the Cubigel library
+
+@section CubigelHost_section Description
+
+This header is only included by "Cubigel.h" when the library is compiled outside of the Arduino
+IDE, i.e. when the "ARDUINO" macro is not defined. It supplies just enough of the Arduino core for
+the Cubigel class to compile and run on a desktop machine so that the FDC1 sentence decoding can be
+measured and regression-tested without any hardware attached. The files in the "extras/host"
+directory use this to drive a simulated compressor through the library.
+
+The "millis()" function returns a simulated clock which is advanced by the host program using
+"CubigelHost::advance()", since the compressor timing itself is simulated. The "micros()" function
+returns the real monotonic clock so that it can be used for timing measurements. Interrupts do not
+exist on the host so "noInterrupts()" and "interrupts()" do nothing, and the serial ports are simple
+in-memory FIFOs which the simulator writes into and reads from.
+
+@section CubigelHostLicense License
+
+This program is free software: you can redistribute it and/or modify it under the terms of the GNU
+General Public License as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version. This program is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details. You should have
+received a copy of the GNU General Public License along with this program.  If not, see
+<http://www.gnu.org/licenses/>.
+*/
+// clang-format on
+
+#ifndef CubigelHost_h                     // Guard code definition
+  #define CubigelHost_h                   ///< Define the name inside guard code
+  #include <stddef.h>                     // size_t definition
+  #include <stdint.h>                     // Fixed-width integer types
+  #include <string.h>                     // memset() and memcpy()
+  #include <time.h>                       // clock_gettime() for micros()
+const uint16_t CUBIGEL_HOST_RX_SIZE{64};  ///< Same as the Arduino serial receive buffer size
+namespace CubigelHost {
+inline uint32_t &clock() {
+  /*!
+    @brief   Storage for the simulated millisecond clock
+    @return  Reference to the simulated clock value
+  */
+  static uint32_t simulatedMillis = 0;  // Simulated milliseconds since start
+  return simulatedMillis;
+}  // of function clock()
+inline void advance(const uint32_t milliseconds) {
+  /*!
+    @brief     Advance the simulated millisecond clock
+    @param[in] milliseconds Number of milliseconds to move the clock forward
+  */
+  clock() += milliseconds;
+}  // of function advance()
+inline uint32_t nanos() {
+  /*!
+    @brief   Monotonic nanosecond clock used for the CUBIGEL_PROFILE timings, wraps every 4.3s
+    @return  Nanoseconds taken from the monotonic system clock
+  */
+  struct timespec now;                   // Current monotonic time
+  clock_gettime(CLOCK_MONOTONIC, &now);  // Read the system clock
+  return (uint32_t)((uint64_t)now.tv_sec * 1000000000 + now.tv_nsec);
+}  // of function nanos()
+}  // namespace CubigelHost
+inline uint32_t millis() {
+  /*!
+    @brief   Host replacement for the Arduino millis() function
+    @return  Simulated milliseconds since start
+  */
+  return CubigelHost::clock();
+}  // of function millis()
+inline uint32_t micros() {
+  /*!
+    @brief   Host replacement for the Arduino micros() function
+    @return  Microseconds taken from the monotonic system clock
+  */
+  struct timespec now;                   // Current monotonic time
+  clock_gettime(CLOCK_MONOTONIC, &now);  // Read the system clock
+  return (uint32_t)((uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000);
+}  // of function micros()
+inline void noInterrupts() {}  ///< There are no interrupts to disable on the host
+inline void interrupts() {}    ///< There are no interrupts to enable on the host
+
+class Stream {
+  /*!
+   * @class Stream
+   * @brief Minimal version of the Arduino "Stream" class with just the members used by the library
+   */
+ public:
+  virtual ~Stream() {}                                ///< Virtual destructor
+  virtual int    available()                = 0;      ///< Number of bytes ready to read
+  virtual int    read()                     = 0;      ///< Read next byte, -1 when empty
+  virtual size_t write(const uint8_t value) = 0;      ///< Write a single byte
+  virtual int    availableForWrite() { return 0; }    ///< Free bytes in the write buffer
+};  // of class Stream
+
+class CubigelHostSerial : public Stream {
+  /*!
+   * @class CubigelHostSerial
+   * @brief In-memory serial port. Bytes "received" from the compressor are injected by the host
+   *        program and bytes "transmitted" to it are collected in a separate FIFO
+   */
+ public:
+  CubigelHostSerial(const uint32_t rxSize = CUBIGEL_HOST_RX_SIZE) : _rxSize(rxSize) {
+    /*!
+      @brief     Class constructor
+      @param[in] rxSize Size of the receive buffer, defaults to the Arduino buffer size
+    */
+    _rxBuffer = new uint8_t[_rxSize];
+  }                                              // of constructor
+  ~CubigelHostSerial() { delete[] _rxBuffer; }   ///< Free the receive buffer
+  void begin(const long baud) { _baud = baud; }  ///< Store the baud rate, nothing else to do
+  long baud() const { return _baud; }            ///< Return the baud rate set in begin()
+  int  available() {
+    /*!
+      @brief   Return the number of received bytes waiting to be read
+      @return  Number of bytes in the receive FIFO
+    */
+    return (int)_rxCount;
+  }  // of method available()
+  int read() {
+    /*!
+      @brief   Read the next byte from the receive FIFO
+      @return  Byte value or -1 if the FIFO is empty
+    */
+    if (_rxCount == 0) return -1;             // Nothing to read
+    uint8_t value = _rxBuffer[_rxTail];       // Get the oldest byte
+    _rxTail       = (_rxTail + 1) % _rxSize;  // Move past it
+    --_rxCount;                               // and count it as read
+    return value;
+  }  // of method read()
+  size_t write(const uint8_t value) {
+    /*!
+      @brief     Store a byte sent to the compressor in the transmit FIFO
+      @param[in] value Byte to transmit
+      @return    Number of bytes written, 0 if the transmit FIFO is full
+    */
+    if (_txCount == sizeof(_txBuffer)) return 0;  // No space left
+    _txBuffer[(_txTail + _txCount++) % sizeof(_txBuffer)] = value;
+    return 1;
+  }                                                                        // of method write()
+  int availableForWrite() { return (int)(sizeof(_txBuffer) - _txCount); }  ///< Free TX space
+  bool inject(const uint8_t value) {
+    /*!
+      @brief     Called by the host program to place a byte into the receive FIFO as if it had
+                 arrived from the compressor
+      @param[in] value Byte to inject
+      @return    false if the receive FIFO was full and the byte was lost
+    */
+    if (_rxCount == _rxSize) {  // Buffer full, just like the Arduino
+      ++_overflows;             // the byte is dropped
+      return false;
+    }  // of if-then the buffer is full
+    _rxBuffer[(_rxTail + _rxCount++) % _rxSize] = value;
+    return true;
+  }  // of method inject()
+  int transmitted() {
+    /*!
+      @brief   Called by the host program to read a byte that the library sent to the compressor
+      @return  Byte value or -1 if nothing has been transmitted
+    */
+    if (_txCount == 0) return -1;                       // Nothing to read
+    uint8_t value = _txBuffer[_txTail];                 // Get the oldest byte
+    _txTail       = (_txTail + 1) % sizeof(_txBuffer);  // Move past it
+    --_txCount;                                         // and count it as read
+    return value;
+  }                                                  // of method transmitted()
+  uint32_t overflows() const { return _overflows; }  ///< Bytes lost to a full receive FIFO
+  uint32_t rxSize() const { return _rxSize; }        ///< Size of the receive FIFO
+
+ private:
+  CubigelHostSerial(const CubigelHostSerial &);             // Not copyable
+  CubigelHostSerial &operator=(const CubigelHostSerial &);  // Not assignable
+  uint8_t *          _rxBuffer;                             // Receive FIFO storage
+  uint32_t           _rxSize;                               // Receive FIFO size
+  uint32_t           _rxTail    = 0;                        // Oldest byte in receive FIFO
+  uint32_t           _rxCount   = 0;                        // Bytes in receive FIFO
+  uint32_t           _overflows = 0;                        // Bytes lost to a full FIFO
+  uint8_t            _txBuffer[64];                         // Transmit FIFO storage
+  uint8_t            _txTail  = 0;                          // Oldest byte in transmit FIFO
+  uint8_t            _txCount = 0;                          // Bytes in transmit FIFO
+  long               _baud    = 0;                          // Baud rate set by begin()
+};  // of class CubigelHostSerial
+
+class HardwareSerial : public CubigelHostSerial {
+  /*!
+   * @class HardwareSerial
+   * @brief Host stand-in for an Arduino UART
+   */
+ public:
+  HardwareSerial(const uint32_t rxSize = CUBIGEL_HOST_RX_SIZE) : CubigelHostSerial(rxSize) {}
+};  // of class HardwareSerial
+
+class SoftwareSerial : public CubigelHostSerial {
+  /*!
+   * @class SoftwareSerial
+   * @brief Host stand-in for the Arduino SoftwareSerial library, the pins are ignored
+   */
+ public:
+  SoftwareSerial(const uint8_t rxPin, const uint8_t txPin, const bool inverse = false,
+                 const uint32_t rxSize = CUBIGEL_HOST_RX_SIZE)
+      : CubigelHostSerial(rxSize) {
+    (void)rxPin;    // The pins have no meaning
+    (void)txPin;    // on the host
+    (void)inverse;  //
+  }                 // of constructor
+};  // of class SoftwareSerial
+#endif